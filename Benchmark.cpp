@@ -0,0 +1,286 @@
+// Standalone engine benchmark: loads a feed, generates a seeded query workload and runs it through
+// runMultiCriteriaRaptor on one thread and then on several, reporting latency percentiles,
+// throughput and heap allocations as JSON on stdout. Two runs with the same feed, seed and options
+// answer the same queries, so their reports can be compared across engine changes.
+//
+//     Benchmark <feed dir> [--queries N] [--seed S] [--threads T] [--warmup N]
+//               [--workload random|realistic] [--criteria walking,fare]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DataTypes.h"
+#include "Raptor.h"
+#include "Timetable.h"
+#include "SimdKernels.h"
+#include "JsonWriter.h"
+
+// Heap use is counted per thread by replacing the global allocation functions, so counting adds
+// no shared writes to the multi-threaded run
+static thread_local uint64_t thread_allocations = 0;
+static thread_local uint64_t thread_allocated_bytes = 0;
+
+void* operator new(size_t size) {
+    ++thread_allocations;
+    thread_allocated_bytes += size;
+    if (void* block = std::malloc(size ? size : 1)) return block;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* block) noexcept { std::free(block); }
+void operator delete[](void* block) noexcept { std::free(block); }
+void operator delete(void* block, size_t) noexcept { std::free(block); }
+void operator delete[](void* block, size_t) noexcept { std::free(block); }
+
+struct BenchmarkQuery {
+    int from;
+    int to;
+    Time time;
+};
+
+struct BenchmarkOptions {
+    std::string feed_dir;
+    int queries = 1000;
+    uint64_t seed = 1;
+    int threads = 0; // 0: one per hardware thread
+    int warmup = 50;
+    std::string workload = "random";
+    RaptorCriteria criteria;
+};
+
+// What one query cost and found
+struct QuerySample {
+    int64_t micros;
+    uint64_t allocations;
+    uint64_t allocated_bytes;
+    int journeys;
+};
+
+// std::uniform_int_distribution differs between standard libraries; this does not, so a seed
+// names the same workload everywhere
+static uint64_t below(std::mt19937_64& rng, uint64_t bound) {
+    return rng() % bound;
+}
+
+// Picks an index with probability proportional to its weight; `cumulative` holds running sums
+static size_t weightedPick(std::mt19937_64& rng, const std::vector<uint64_t>& cumulative) {
+    uint64_t target = below(rng, cumulative.back());
+    return std::upper_bound(cumulative.begin(), cumulative.end(), target) - cumulative.begin();
+}
+
+// Uniformly random origins, destinations and departures between 05:00 and 23:00
+static std::vector<BenchmarkQuery> randomWorkload(const std::vector<int>& stop_ids, int count, std::mt19937_64& rng) {
+    std::vector<BenchmarkQuery> queries;
+    while (static_cast<int>(queries.size()) < count) {
+        int from = stop_ids[below(rng, stop_ids.size())];
+        int to = stop_ids[below(rng, stop_ids.size())];
+        if (from == to) continue;
+        queries.push_back({from, to, Time::fromSeconds(5 * 3600 + static_cast<int>(below(rng, 18 * 3600)))});
+    }
+    return queries;
+}
+
+// Origins and destinations weighted by how many route patterns serve them, so hubs dominate as
+// they do in real traffic, and departures clustered around the 08:00 and 18:00 peaks
+static std::vector<BenchmarkQuery> realisticWorkload(const Timetable& timetable, const std::vector<int>& stop_ids, int count, std::mt19937_64& rng) {
+    std::vector<uint64_t> cumulative;
+    uint64_t total = 0;
+    for (int stop_id : stop_ids) {
+        auto serving = timetable.patterns_serving_stop.find(stop_id);
+        total += serving == timetable.patterns_serving_stop.end() ? 0 : serving->second.size() * serving->second.size();
+        cumulative.push_back(total);
+    }
+    if (total == 0) return randomWorkload(stop_ids, count, rng);
+
+    // Hourly departure weights from 05:00 to 22:00
+    static const uint64_t HOUR_WEIGHTS[] = {2, 5, 12, 16, 12, 7, 5, 5, 6, 6, 6, 7, 10, 15, 12, 7, 4, 3};
+    std::vector<uint64_t> hours;
+    uint64_t hour_total = 0;
+    for (uint64_t weight : HOUR_WEIGHTS) hours.push_back(hour_total += weight);
+
+    std::vector<BenchmarkQuery> queries;
+    while (static_cast<int>(queries.size()) < count) {
+        int from = stop_ids[weightedPick(rng, cumulative)];
+        int to = stop_ids[weightedPick(rng, cumulative)];
+        if (from == to) continue;
+        int hour = 5 + static_cast<int>(weightedPick(rng, hours));
+        queries.push_back({from, to, Time::fromSeconds(hour * 3600 + static_cast<int>(below(rng, 3600)))});
+    }
+    return queries;
+}
+
+static QuerySample runQuery(const BenchmarkQuery& query, const Timetable& timetable, const RaptorCriteria& criteria) {
+    uint64_t allocations = thread_allocations;
+    uint64_t allocated_bytes = thread_allocated_bytes;
+    auto started = std::chrono::steady_clock::now();
+
+    std::map<int, std::vector<Journey>> final_profiles;
+    // Reused per thread, as the server's workers do
+    static thread_local RoundLabels labels;
+    runMultiCriteriaRaptor(query.from, query.to, query.time, timetable, final_profiles, labels, DEFAULT_HORIZON_SECONDS, criteria);
+    auto destination = final_profiles.find(query.to);
+    int journeys = destination == final_profiles.end() ? 0 : static_cast<int>(destination->second.size());
+    // Rebuilding the legs is part of answering a query
+    if (destination != final_profiles.end()) {
+        for (const auto& journey : destination->second) reconstructLegs(journey, labels, timetable);
+    }
+
+    int64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+    return {micros, thread_allocations - allocations, thread_allocated_bytes - allocated_bytes, journeys};
+}
+
+// Runs every query on `threads` threads, which take the next unanswered query until none is left.
+// Returns the wall-clock time of the whole run.
+static double runAll(const std::vector<BenchmarkQuery>& queries, const Timetable& timetable, const RaptorCriteria& criteria,
+                     int threads, std::vector<QuerySample>& samples) {
+    samples.assign(queries.size(), QuerySample());
+    std::atomic<size_t> next_query{0};
+    auto work = [&]() {
+        for (size_t i = next_query++; i < queries.size(); i = next_query++) samples[i] = runQuery(queries[i], timetable, criteria);
+    };
+    auto started = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; ++t) workers.emplace_back(work);
+    work();
+    for (auto& worker : workers) worker.join();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
+
+// Nearest-rank percentile of sorted values
+static int64_t percentile(const std::vector<int64_t>& sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(fraction * sorted.size() + 0.999999);
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+static void writeRun(JsonWriter& json, const char* name, int threads, double seconds, const std::vector<QuerySample>& samples) {
+    std::vector<int64_t> latencies;
+    uint64_t allocations = 0, allocated_bytes = 0;
+    int64_t journeys = 0;
+    for (const auto& sample : samples) {
+        latencies.push_back(sample.micros);
+        allocations += sample.allocations;
+        allocated_bytes += sample.allocated_bytes;
+        journeys += sample.journeys;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double count = std::max<double>(1, samples.size());
+    double mean = 0;
+    for (int64_t latency : latencies) mean += latency;
+
+    json.key(name).beginObject()
+        .key("threads").number(threads)
+        .key("seconds").number(seconds)
+        .key("queries_per_second").number(samples.size() / seconds)
+        .key("latency_us").beginObject()
+            .key("mean").number(mean / count)
+            .key("p50").number(percentile(latencies, 0.50))
+            .key("p95").number(percentile(latencies, 0.95))
+            .key("p99").number(percentile(latencies, 0.99))
+            .key("max").number(latencies.empty() ? 0 : latencies.back())
+        .endObject()
+        .key("allocations_per_query").number(allocations / count)
+        .key("allocated_bytes_per_query").number(allocated_bytes / count)
+        // Equal between runs that found the same journeys
+        .key("journeys").number(journeys)
+        .endObject();
+}
+
+static bool parseOptions(int argc, char** argv, BenchmarkOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--queries" && has_value) options.queries = std::max(1, atoi(argv[++i]));
+        else if (arg == "--seed" && has_value) options.seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--threads" && has_value) options.threads = std::max(0, atoi(argv[++i]));
+        else if (arg == "--warmup" && has_value) options.warmup = std::max(0, atoi(argv[++i]));
+        else if (arg == "--workload" && has_value) {
+            options.workload = argv[++i];
+            if (options.workload != "random" && options.workload != "realistic") return false;
+        } else if (arg == "--criteria" && has_value) {
+            std::stringstream names(argv[++i]);
+            std::string name;
+            while (std::getline(names, name, ',')) {
+                if (name == "walking") options.criteria.walking = true;
+                else if (name == "fare") options.criteria.fare = true;
+                else return false;
+            }
+        } else if (arg[0] != '-' && options.feed_dir.empty()) {
+            options.feed_dir = arg;
+        } else {
+            return false;
+        }
+    }
+    return !options.feed_dir.empty();
+}
+
+int main(int argc, char** argv) {
+    BenchmarkOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "usage: %s <feed dir> [--queries N] [--seed S] [--threads T] [--warmup N]\n"
+                        "       [--workload random|realistic] [--criteria walking,fare]\n", argv[0]);
+        return 2;
+    }
+    if (options.threads == 0) options.threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::shared_ptr<const Timetable> timetable;
+    auto load_started = std::chrono::steady_clock::now();
+    try {
+        timetable = loadTimetable(options.feed_dir, 1);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "Failed to load GTFS data: %s\n", e.what());
+        return 1;
+    }
+    double load_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - load_started).count();
+
+    std::vector<int> stop_ids;
+    for (const auto& pair : timetable->stops) stop_ids.push_back(pair.first);
+    if (stop_ids.size() < 2) {
+        fprintf(stderr, "The feed needs at least two stops\n");
+        return 1;
+    }
+    std::mt19937_64 rng(options.seed);
+    std::vector<BenchmarkQuery> queries = options.workload == "realistic"
+        ? realisticWorkload(*timetable, stop_ids, options.queries, rng)
+        : randomWorkload(stop_ids, options.queries, rng);
+
+    // Warm caches and the allocator on the first queries; their results are discarded
+    std::vector<QuerySample> samples;
+    std::vector<BenchmarkQuery> warmup(queries.begin(), queries.begin() + std::min<size_t>(options.warmup, queries.size()));
+    runAll(warmup, *timetable, options.criteria, 1, samples);
+
+    std::string report;
+    JsonWriter json(report);
+    json.beginObject()
+        .key("feed").string(options.feed_dir)
+        .key("stops").number(static_cast<int64_t>(timetable->stops.size()))
+        .key("trips").number(static_cast<int64_t>(timetable->trip_count))
+        .key("patterns").number(static_cast<int64_t>(timetable->patterns.size()))
+        .key("load_seconds").number(load_seconds)
+        .key("kernels").string(simdLevelName())
+        .key("workload").string(options.workload)
+        .key("seed").number(static_cast<int64_t>(options.seed))
+        .key("queries").number(options.queries)
+        .key("criteria").beginArray();
+    if (options.criteria.walking) json.string("walking");
+    if (options.criteria.fare) json.string("fare");
+    json.endArray();
+
+    double seconds = runAll(queries, *timetable, options.criteria, 1, samples);
+    writeRun(json, "single_thread", 1, seconds, samples);
+    seconds = runAll(queries, *timetable, options.criteria, options.threads, samples);
+    writeRun(json, "multi_thread", options.threads, seconds, samples);
+    json.endObject();
+
+    printf("%s\n", report.c_str());
+    return 0;
+}
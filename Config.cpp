@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "Config.h"
+#include "SimdKernels.h"
+
+namespace {
+
+// One setting; exactly one of the member pointers is set
+struct Setting {
+    const char* key;
+    std::string ServerConfig::* text;
+    int ServerConfig::* integer;
+    double ServerConfig::* real;
+    const char* help;
+};
+
+const Setting SETTINGS[] = {
+    {"data_dir", &ServerConfig::data_dir, nullptr, nullptr, "directory of the GTFS feed"},
+    {"web_dir", &ServerConfig::web_dir, nullptr, nullptr, "directory of the web UI files"},
+    {"host", &ServerConfig::host, nullptr, nullptr, "address to listen on"},
+    {"port", nullptr, &ServerConfig::port, nullptr, "port to listen on"},
+    {"listeners", nullptr, &ServerConfig::listeners, nullptr, "event loops, each on its own socket (Linux); 0: min(4, cores)"},
+    {"workers", nullptr, &ServerConfig::workers, nullptr, "threads running requests; 0: one per core"},
+    {"backlog", nullptr, &ServerConfig::backlog, nullptr, "accept queue length (Linux)"},
+    {"keep_alive_seconds", nullptr, &ServerConfig::keep_alive_seconds, nullptr, "idle time before a connection is closed"},
+    {"batch_threads", nullptr, &ServerConfig::batch_threads, nullptr, "queries of one batch request running at once; 0: one per worker"},
+    {"max_batch_queries", nullptr, &ServerConfig::max_batch_queries, nullptr, "queries allowed in one batch request"},
+    {"max_batch_bytes", nullptr, &ServerConfig::max_batch_bytes, nullptr, "largest batch request body"},
+    {"rounds", nullptr, &ServerConfig::rounds, nullptr, "default round limit (trips per journey)"},
+    {"max_rounds", nullptr, &ServerConfig::max_rounds, nullptr, "highest ?rounds= a request may ask for"},
+    {"walk_meters", nullptr, nullptr, &ServerConfig::walk_meters, "default walk radius at either end"},
+    {"max_walk_meters", nullptr, nullptr, &ServerConfig::max_walk_meters, "highest ?walk= a request may ask for; at most 10000"},
+    {"walking_speed_mps", nullptr, nullptr, &ServerConfig::walking_speed_mps, "walking speed in meters per second"},
+    {"time_budget_ms", nullptr, &ServerConfig::time_budget_ms, nullptr, "search time per query; 0: unlimited"},
+    {"max_horizon_hours", nullptr, &ServerConfig::max_horizon_hours, nullptr, "highest ?horizon= a request may ask for"},
+    {"log_sample_every", nullptr, &ServerConfig::log_sample_every, nullptr, "log one request line in this many"},
+};
+
+const char* const LOG_LEVEL_NAMES[] = {"debug", "info", "warn", "error"};
+
+// Sets `key`; returns false if there is no such setting. Throws std::invalid_argument for a bad value.
+bool applySetting(ServerConfig& config, const std::string& key, const std::string& value) {
+    if (key == "log_level") {
+        for (int level = LOG_DEBUG; level <= LOG_ERROR; ++level) {
+            if (value == LOG_LEVEL_NAMES[level]) {
+                config.log_level = static_cast<LogLevel>(level);
+                return true;
+            }
+        }
+        throw std::invalid_argument("expected debug, info, warn or error");
+    }
+    for (const auto& setting : SETTINGS) {
+        if (key != setting.key) continue;
+        char* end = nullptr;
+        errno = 0;
+        if (setting.text) {
+            config.*setting.text = value;
+        } else if (setting.integer) {
+            long number = std::strtol(value.c_str(), &end, 10);
+            if (value.empty() || *end || errno || number < 0 || number > 1000000000) throw std::invalid_argument("expected a non-negative integer");
+            config.*setting.integer = static_cast<int>(number);
+        } else {
+            double number = std::strtod(value.c_str(), &end);
+            if (value.empty() || *end || errno || !(number >= 0)) throw std::invalid_argument("expected a non-negative number");
+            config.*setting.real = number;
+        }
+        return true;
+    }
+    return false;
+}
+
+std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) return "";
+    return text.substr(begin, text.find_last_not_of(" \t\r") - begin + 1);
+}
+
+} // namespace
+
+void loadConfigFile(const std::string& path, ServerConfig& config) {
+    std::ifstream file(path);
+    if (!file) throw std::runtime_error("Cannot open config file " + path);
+    std::string line;
+    for (int line_number = 1; std::getline(file, line); ++line_number) {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+        std::string where = path + ":" + std::to_string(line_number) + ": ";
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) throw std::runtime_error(where + "expected key = value");
+        std::string key = trim(line.substr(0, equals));
+        try {
+            if (!applySetting(config, key, trim(line.substr(equals + 1)))) throw std::runtime_error(where + "unknown setting " + key);
+        } catch (const std::invalid_argument& e) {
+            throw std::runtime_error(where + key + ": " + e.what());
+        }
+    }
+}
+
+bool parseCommandLine(int argc, char* argv[], ServerConfig& config) {
+    // The file first, wherever --config appears, so that the command line wins
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") return false;
+        if (arg.compare(0, 9, "--config=") == 0) loadConfigFile(arg.substr(9), config);
+        else if (arg == "--config" && i + 1 < argc) loadConfigFile(argv[++i], config);
+    }
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) throw std::runtime_error("Unexpected argument " + arg);
+        std::string key = arg.substr(2), value;
+        size_t equals = key.find('=');
+        if (equals != std::string::npos) {
+            value = key.substr(equals + 1);
+            key.erase(equals);
+        } else if (i + 1 < argc) {
+            value = argv[++i];
+        } else {
+            throw std::runtime_error("Missing value for " + arg);
+        }
+        if (key == "config") continue;
+        try {
+            if (!applySetting(config, key, value)) throw std::runtime_error("Unknown option " + arg);
+        } catch (const std::invalid_argument& e) {
+            throw std::runtime_error("--" + key + ": " + e.what());
+        }
+    }
+    return true;
+}
+
+void validateConfig(const ServerConfig& config) {
+    auto require = [](bool ok, const char* message) {
+        if (!ok) throw std::runtime_error(message);
+    };
+    require(config.port >= 1 && config.port <= 65535, "port must be between 1 and 65535");
+    require(config.backlog >= 1, "backlog must be at least 1");
+    require(config.max_batch_queries >= 1, "max_batch_queries must be at least 1");
+    require(config.max_batch_bytes >= 2, "max_batch_bytes must be at least 2");
+    require(config.log_sample_every >= 1, "log_sample_every must be at least 1");
+    require(config.max_horizon_hours >= 1, "max_horizon_hours must be at least 1");
+    require(config.rounds >= 1, "rounds must be at least 1");
+    // Labels store their round in 16 bits; far more rounds than any journey needs
+    require(config.max_rounds <= 64, "max_rounds must be at most 64");
+    require(config.rounds <= config.max_rounds, "rounds must not exceed max_rounds");
+    require(config.walk_meters <= config.max_walk_meters, "walk_meters must not exceed max_walk_meters");
+    // Walk candidates come from filterNearbyStops, which may miss stops further away
+    require(config.max_walk_meters <= NEARBY_FILTER_MAX_METERS, "max_walk_meters must be at most 10000");
+    require(config.walking_speed_mps > 0, "walking_speed_mps must be positive");
+}
+
+std::string configUsage(const char* program) {
+    const ServerConfig defaults;
+    std::ostringstream usage;
+    usage << "usage: " << program << " [--config <file>] [--<setting> <value>]...\n"
+          << "Settings, also accepted as `setting = value` lines in the config file:\n";
+    for (const auto& setting : SETTINGS) {
+        usage << "  " << setting.key << " (";
+        if (setting.text) usage << '"' << defaults.*setting.text << '"';
+        else if (setting.integer) usage << defaults.*setting.integer;
+        else usage << defaults.*setting.real;
+        usage << ")  " << setting.help << "\n";
+    }
+    usage << "  log_level (" << LOG_LEVEL_NAMES[defaults.log_level] << ")  debug, info, warn or error\n";
+    return usage.str();
+}
+
+RaptorLimits queryLimits(const ServerConfig& config, int rounds, double walk_meters, int budget_ms) {
+    RaptorLimits limits;
+    limits.max_trips = rounds < 0 ? config.rounds : std::max(1, std::min(rounds, config.max_rounds));
+    limits.max_walk_meters = walk_meters < 0 ? config.walk_meters : std::min(walk_meters, config.max_walk_meters);
+    limits.walking_speed_mps = config.walking_speed_mps;
+    int budget = config.time_budget_ms;
+    if (budget_ms > 0) budget = budget > 0 ? std::min(budget, budget_ms) : budget_ms;
+    if (budget > 0) limits.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(budget);
+    return limits;
+}
@@ -0,0 +1,60 @@
+#ifndef CONFIG_H_INCLUDED
+#define CONFIG_H_INCLUDED
+
+#include <cstddef>
+#include <string>
+#include "Raptor.h"
+#include "Logger.h"
+
+// Server settings: compiled-in defaults, overridden by a config file and then by the command
+// line. Both use the same keys; the file has one `key = value` per line, the command line
+// `--key=value` or `--key value`.
+struct ServerConfig {
+    std::string data_dir = "./";      // GTFS feed, also reloaded from here
+    std::string web_dir = "./";       // web UI files
+
+    // Listener
+    std::string host = "localhost";
+    int port = 8080;
+    int listeners = 0;                // epoll listeners; 0 means one per hardware thread, at most 4
+    int workers = 0;                  // threads running requests; 0 means one per hardware thread
+    int backlog = 4096;
+    int keep_alive_seconds = 5;
+    int batch_threads = 0;            // queries of one /api/route/batch request running at once; 0 as for workers
+    int max_batch_queries = 10000;
+    int max_batch_bytes = 4 * 1024 * 1024; // request body limit; /api/route/batch is the only route with a body
+
+    // Engine. Each query starts from the first value of a pair; a request may change it, but
+    // never beyond the second.
+    int rounds = MAX_TRIPS;           // ?rounds=
+    int max_rounds = 8;
+    double walk_meters = MAX_WALK_DISTANCE_METERS; // ?walk=
+    double max_walk_meters = 3000;    // at most NEARBY_FILTER_MAX_METERS
+    double walking_speed_mps = WALKING_SPEED_MPS;
+    int time_budget_ms = 0;           // ?budget_ms=; 0 means none. Requests may only shorten it.
+    int max_horizon_hours = 72;       // cap for ?horizon=
+
+    // Logging
+    LogLevel log_level = LOG_INFO;
+    int log_sample_every = 1;
+};
+
+// Applies the settings in `path`. '#' starts a comment. Throws std::runtime_error for a file
+// that can't be read, an unknown key or a bad value, naming the line.
+void loadConfigFile(const std::string& path, ServerConfig& config);
+
+// Applies `--config <file>` first, then every other option on top of it. Returns false if
+// --help was given. Throws std::runtime_error like loadConfigFile.
+bool parseCommandLine(int argc, char* argv[], ServerConfig& config);
+
+// Checks ranges and that every default is within its cap; throws std::runtime_error
+void validateConfig(const ServerConfig& config);
+
+// Options and defaults, for --help
+std::string configUsage(const char* program);
+
+// The limits for one query: the configured defaults, with whatever the request asked for
+// clamped to the caps. Negative request values mean "not given".
+RaptorLimits queryLimits(const ServerConfig& config, int rounds = -1, double walk_meters = -1, int budget_ms = -1);
+
+#endif // CONFIG_H_INCLUDED
@@ -7,9 +7,13 @@
 #include <string>
 #include <cstdio>
 #include <cmath> // --- NEW --- For math functions
+#include "StringPool.h"
 
 // --- Core Data Structures ---
 
+// GTFS service days; trip times past 24:00:00 belong to the previous day's service
+const int SECONDS_PER_DAY = 24 * 3600;
+
 struct Time {
     int h = 0, m = 0, s = 0;
     Time() = default;
@@ -30,20 +34,29 @@ struct Time {
 
 struct Stop {
     int id;
-    std::string name;
+    StringId name = NO_STRING; // interned in Timetable::strings
     double lat = 0.0;
     double lon = 0.0;
+    bool has_location = false; // false when the feed has no stop_lat/stop_lon for this stop
+    StringId zone_id = NO_STRING; // fare zone, matched against fare_rules origin/destination
 };
 
-struct StopTime { std::string trip_id; Time arrival_time; Time departure_time; int stop_id; int stop_sequence; };
-struct Transfer { int from_stop_id; int to_stop_id; int duration_seconds; };
+struct StopTime { StringId trip_id; Time arrival_time; Time departure_time; int stop_id; int stop_sequence; };
+struct Transfer { int from_stop_id; int to_stop_id; int duration_seconds; int distance_meters = 0; };
+
+// How a Journey reached its stop
+enum JourneyMethod { METHOD_START, METHOD_WALK, METHOD_TRIP };
 
 struct Journey {
     Time arrival_time;
     int trips;
     Time departure_time;
     int from_stop_id = -1;
-    std::string method;
+    JourneyMethod method = METHOD_START;
+    StringId trip_id = NO_STRING; // set for METHOD_TRIP
+    int walk_meters = 0;          // total walked so far
+    int fare = 0;                 // total fare so far, in minor currency units; only priced for the fare criterion
+    int label_index = -1;         // the search label behind this journey, in round `trips`
 };
 
 // --- Helper Functions ---
@@ -0,0 +1,612 @@
+#ifdef __linux__
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "EpollServer.h"
+#include "Logger.h"
+
+// Fixed set of threads running queued jobs in order. Destroying the pool runs the jobs still
+// queued before the threads exit.
+class WorkerPool {
+public:
+    explicit WorkerPool(int threads) {
+        for (int i = 0; i < threads; ++i) threads_.emplace_back([this] { run(); });
+    }
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        ready_.notify_all();
+        for (auto& thread : threads_) thread.join();
+    }
+
+    void submit(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back(std::move(job));
+        }
+        ready_.notify_one();
+    }
+
+private:
+    void run() {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                ready_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+                if (jobs_.empty()) return;
+                job = std::move(jobs_.front());
+                jobs_.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::vector<std::thread> threads_;
+    std::deque<std::function<void()>> jobs_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    bool stopping_ = false;
+};
+
+struct Connection {
+    int fd = -1;
+    uint64_t id = 0;               // fds are reused; ids are not
+    std::string remote_addr;
+    std::string input;             // received bytes not yet parsed into a request
+    std::string output;            // response bytes not yet sent
+    size_t written = 0;            // of `output`
+    bool busy = false;             // a worker is answering the current request
+    bool close_after_write = false;
+    std::shared_ptr<std::atomic<bool>> closed; // tells a streaming handler that the client left
+    // Set as well when the socket hangs up or fails: a search for it may stop early. A client
+    // that only shuts down its sending side still reads the answer, so end of input is not enough.
+    std::shared_ptr<std::atomic<bool>> hung_up;
+    std::chrono::steady_clock::time_point last_active;
+};
+
+// Response bytes a worker hands to the loop that owns the connection
+struct PostedOutput {
+    int fd;
+    uint64_t id;
+    std::string bytes;
+    bool last;  // the response is complete
+    bool close; // close the connection once it is sent
+};
+
+static bool equalsIgnoreCase(const std::string& a, const char* b) {
+    return a.size() == strlen(b) && strncasecmp(a.c_str(), b, a.size()) == 0;
+}
+
+static std::string responseHead(const httplib::Response& res, bool keep_alive, bool chunked, size_t length) {
+    std::string head = "HTTP/1.1 " + std::to_string(res.status) + " " + httplib::status_message(res.status) + "\r\n";
+    for (const auto& header : res.headers) {
+        if (equalsIgnoreCase(header.first, "Content-Length") || equalsIgnoreCase(header.first, "Transfer-Encoding") ||
+            equalsIgnoreCase(header.first, "Connection")) continue;
+        head += header.first + ": " + header.second + "\r\n";
+    }
+    head += chunked ? "Transfer-Encoding: chunked\r\n" : "Content-Length: " + std::to_string(length) + "\r\n";
+    head += keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    return head;
+}
+
+// One chunk of a chunked body
+static std::string chunkBytes(const char* data, size_t length) {
+    char size_line[24];
+    snprintf(size_line, sizeof(size_line), "%zx\r\n", length);
+    return size_line + std::string(data, length) + "\r\n";
+}
+
+// Parses the request line and headers, which end at `header_end` (the blank line)
+static bool parseRequestHead(const std::string& input, size_t header_end, httplib::Request& req) {
+    size_t line_end = input.find("\r\n");
+    std::istringstream request_line(input.substr(0, line_end));
+    if (!(request_line >> req.method >> req.target >> req.version)) return false;
+    if (req.version != "HTTP/1.1" && req.version != "HTTP/1.0") return false;
+
+    size_t query = req.target.find('?');
+    req.path = httplib::decode_path_component(req.target.substr(0, query));
+    if (query != std::string::npos) httplib::detail::parse_query_text(req.target.substr(query + 1), req.params);
+
+    for (size_t start = line_end + 2; start < header_end;) {
+        size_t end = input.find("\r\n", start);
+        if (end == std::string::npos || end > header_end) end = header_end;
+        size_t colon = input.find(':', start);
+        if (colon == std::string::npos || colon > end) return false;
+        size_t value = colon + 1;
+        while (value < end && (input[value] == ' ' || input[value] == '\t')) ++value;
+        size_t value_end = end;
+        while (value_end > value && (input[value_end - 1] == ' ' || input[value_end - 1] == '\t')) --value_end;
+        req.headers.emplace(input.substr(start, colon - start), input.substr(value, value_end - value));
+        start = end + 2;
+    }
+    return true;
+}
+
+// One listening socket and the connections accepted on it, driven by one thread
+class EventLoop {
+public:
+    EventLoop(const EpollServer& server, WorkerPool& workers, const ListenerOptions& options, const std::atomic<bool>& stopping)
+        : server_(server), workers_(workers), options_(options), stopping_(stopping) {}
+
+    ~EventLoop() {
+        for (int fd : {listen_fd_, epoll_fd_, wake_fd_}) {
+            if (fd >= 0) ::close(fd);
+        }
+    }
+
+    // Binds the listening socket; every loop binds the same address, and SO_REUSEPORT makes the
+    // kernel spread new connections over them
+    bool open(std::string& error) {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        addrinfo* addresses = nullptr;
+        int status = getaddrinfo(options_.host.c_str(), std::to_string(options_.port).c_str(), &hints, &addresses);
+        if (status != 0) {
+            error = gai_strerror(status);
+            return false;
+        }
+        error = "no usable address";
+        for (addrinfo* address = addresses; address && listen_fd_ < 0; address = address->ai_next) {
+            int fd = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address->ai_protocol);
+            if (fd < 0) continue;
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+            if (bind(fd, address->ai_addr, address->ai_addrlen) == 0 && ::listen(fd, options_.backlog) == 0) {
+                listen_fd_ = fd;
+            } else {
+                error = strerror(errno);
+                ::close(fd);
+            }
+        }
+        freeaddrinfo(addresses);
+        if (listen_fd_ < 0) return false;
+
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epoll_fd_ < 0 || wake_fd_ < 0) {
+            error = strerror(errno);
+            return false;
+        }
+        for (int fd : {listen_fd_, wake_fd_}) {
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+        }
+        return true;
+    }
+
+    void run() {
+        epoll_event events[256];
+        auto last_sweep = std::chrono::steady_clock::now();
+        while (!stopping_) {
+            int count = epoll_wait(epoll_fd_, events, 256, 1000);
+            if (count < 0 && errno != EINTR) break;
+            for (int i = 0; i < count; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == listen_fd_) {
+                    acceptAll();
+                } else if (fd == wake_fd_) {
+                    uint64_t wakeups;
+                    if (::read(wake_fd_, &wakeups, sizeof(wakeups)) < 0 && errno != EAGAIN) break;
+                    drainPosted();
+                } else {
+                    auto it = connections_.find(fd);
+                    if (it == connections_.end()) continue;
+                    if (events[i].events & (EPOLLHUP | EPOLLERR)) it->second.hung_up->store(true);
+                    if ((events[i].events & EPOLLOUT) && !flush(it->second)) continue;
+                    if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) readAll(it->second);
+                }
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (now - last_sweep >= std::chrono::seconds(1)) {
+                closeIdle(now);
+                last_sweep = now;
+            }
+        }
+        for (auto& pair : connections_) {
+            pair.second.closed->store(true);
+            pair.second.hung_up->store(true);
+            ::close(pair.first);
+        }
+        connections_.clear();
+    }
+
+    void wake() {
+        uint64_t one = 1;
+        if (::write(wake_fd_, &one, sizeof(one)) < 0) return; // the counter is already non-zero
+    }
+
+    // Called on worker threads
+    void post(PostedOutput output) {
+        {
+            std::lock_guard<std::mutex> lock(posted_mutex_);
+            posted_.push_back(std::move(output));
+        }
+        wake();
+    }
+
+    // Runs on a worker thread: answers one request and posts the response bytes, chunk by chunk
+    // for chunked content providers
+    void respond(const httplib::Request& req, int fd, uint64_t id, bool keep_alive, const std::shared_ptr<std::atomic<bool>>& closed) {
+        httplib::Response res;
+        bool streamed = false;
+        StreamOpener open = [&](const char* content_type) {
+            httplib::Response head;
+            head.status = 200;
+            head.set_header("Content-Type", content_type);
+            post({fd, id, responseHead(head, keep_alive, true, 0), false, false});
+            streamed = true;
+            return std::make_shared<ResponseStream>(this, fd, id, keep_alive, closed);
+        };
+        server_.dispatch(req, res, open);
+        if (streamed) return; // the stream answers, whatever became of `res`
+        if (res.status == -1) res.status = 200;
+        if (!res.content_provider_) {
+            post({fd, id, responseHead(res, keep_alive, false, res.body.size()) + res.body, true, !keep_alive});
+            return;
+        }
+
+        bool chunked = res.is_chunked_content_provider_;
+        bool done = false;
+        size_t offset = 0;
+        std::string body;
+        httplib::DataSink sink;
+        sink.is_writable = [&] { return !closed->load(); };
+        sink.done = [&] { done = true; };
+        sink.done_with_trailer = [&](const httplib::Headers&) { done = true; };
+        sink.write = [&](const char* data, size_t length) {
+            if (closed->load()) return false;
+            offset += length;
+            if (!chunked) {
+                body.append(data, length);
+            } else if (length > 0) {
+                post({fd, id, chunkBytes(data, length), false, false});
+            }
+            return true;
+        };
+
+        if (chunked) post({fd, id, responseHead(res, keep_alive, true, 0), false, false});
+        // Fixed-length providers stop at their length; the others, like chunked ones, call done()
+        while (!done && !closed->load() && (res.content_length_ == 0 || offset < res.content_length_)) {
+            if (!res.content_provider_(offset, res.content_length_ - std::min(offset, res.content_length_), sink)) break;
+        }
+        res.content_provider_success_ = done || (res.content_length_ > 0 && offset >= res.content_length_);
+        if (chunked) {
+            post({fd, id, res.content_provider_success_ ? "0\r\n\r\n" : "", true, !keep_alive || !res.content_provider_success_});
+        } else {
+            post({fd, id, responseHead(res, keep_alive, false, body.size()) + body, true, !keep_alive});
+        }
+    }
+
+private:
+    void acceptAll() {
+        for (;;) {
+            sockaddr_storage address;
+            socklen_t length = sizeof(address);
+            int fd = accept4(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                return; // EAGAIN: the backlog is empty
+            }
+            if (options_.tcp_nodelay) {
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            }
+            // Edge-triggered for both directions: no epoll_ctl calls after this one
+            epoll_event event = {};
+            event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            event.data.fd = fd;
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+                ::close(fd);
+                continue;
+            }
+            Connection& connection = connections_[fd];
+            connection = Connection();
+            connection.fd = fd;
+            connection.id = next_id_++;
+            connection.closed = std::make_shared<std::atomic<bool>>(false);
+            connection.hung_up = std::make_shared<std::atomic<bool>>(false);
+            connection.last_active = std::chrono::steady_clock::now();
+            char host[INET6_ADDRSTRLEN] = "";
+            if (address.ss_family == AF_INET) inet_ntop(AF_INET, &reinterpret_cast<sockaddr_in*>(&address)->sin_addr, host, sizeof(host));
+            else if (address.ss_family == AF_INET6) inet_ntop(AF_INET6, &reinterpret_cast<sockaddr_in6*>(&address)->sin6_addr, host, sizeof(host));
+            connection.remote_addr = host;
+        }
+    }
+
+    void readAll(Connection& connection) {
+        char buffer[16384];
+        for (;;) {
+            ssize_t count = ::read(connection.fd, buffer, sizeof(buffer));
+            if (count > 0) {
+                connection.input.append(buffer, count);
+                connection.last_active = std::chrono::steady_clock::now();
+                // Requests wait here while the previous one is answered; no complete request is
+                // larger than this, so the client is not waiting for an answer to all of it
+                if (connection.input.size() > options_.max_header_bytes + 4 + options_.max_body_bytes) {
+                    closeConnection(connection);
+                    return;
+                }
+                continue;
+            }
+            if (count < 0 && errno == EINTR) continue;
+            if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (count < 0) {
+                closeConnection(connection);
+                return;
+            }
+            // End of input: HTTP/1.1 allows a half-close, so finish what was asked for, then close
+            connection.close_after_write = true;
+            break;
+        }
+        if (!connection.busy) processInput(connection);
+    }
+
+    // Starts the next complete request, if one has arrived. Returns false if the connection was closed.
+    bool processInput(Connection& connection) {
+        size_t header_end = connection.input.find("\r\n\r\n");
+        if (header_end == std::string::npos || header_end > options_.max_header_bytes) {
+            if (header_end != std::string::npos || connection.input.size() > options_.max_header_bytes) return reject(connection, 431);
+            if (connection.close_after_write && connection.output.empty()) {
+                closeConnection(connection);
+                return false;
+            }
+            return true;
+        }
+
+        httplib::Request req;
+        if (!parseRequestHead(connection.input, header_end, req)) return reject(connection, 400);
+        if (req.has_header("Transfer-Encoding")) return reject(connection, 501); // chunked request bodies
+        size_t body_length = strtoull(req.get_header_value("Content-Length", "0").c_str(), nullptr, 10);
+        if (body_length > options_.max_body_bytes) return reject(connection, 413);
+        size_t request_length = header_end + 4 + body_length;
+        if (connection.input.size() < request_length) {
+            if (connection.close_after_write) {
+                closeConnection(connection);
+                return false;
+            }
+            return true;
+        }
+        req.body = connection.input.substr(header_end + 4, body_length);
+        connection.input.erase(0, request_length);
+        req.remote_addr = connection.remote_addr;
+        auto hung_up = connection.hung_up;
+        req.is_connection_closed = [hung_up] { return hung_up->load(std::memory_order_relaxed); };
+
+        std::string connection_header = req.get_header_value("Connection");
+        bool keep_alive = req.version == "HTTP/1.1" ? !equalsIgnoreCase(connection_header, "close")
+                                                    : equalsIgnoreCase(connection_header, "keep-alive");
+        keep_alive = keep_alive && !connection.close_after_write && !stopping_;
+
+        connection.busy = true;
+        auto request = std::make_shared<httplib::Request>(std::move(req));
+        int fd = connection.fd;
+        uint64_t id = connection.id;
+        auto closed = connection.closed;
+        workers_.submit([this, request, fd, id, keep_alive, closed] { respond(*request, fd, id, keep_alive, closed); });
+        return true;
+    }
+
+    // Answers a malformed or oversized request and closes the connection
+    bool reject(Connection& connection, int status) {
+        connection.output += "HTTP/1.1 " + std::to_string(status) + " " + httplib::status_message(status) +
+                             "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        connection.input.clear();
+        connection.close_after_write = true;
+        return flush(connection);
+    }
+
+    // Sends as much output as the socket takes; EPOLLOUT resumes the rest. Returns false if the
+    // connection was closed.
+    bool flush(Connection& connection) {
+        while (connection.written < connection.output.size()) {
+            ssize_t count = ::send(connection.fd, connection.output.data() + connection.written,
+                                   connection.output.size() - connection.written, MSG_NOSIGNAL);
+            if (count > 0) {
+                connection.written += count;
+                continue;
+            }
+            if (count < 0 && errno == EINTR) continue;
+            if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+            closeConnection(connection);
+            return false;
+        }
+        connection.output.clear();
+        connection.written = 0;
+        if (!connection.busy && connection.close_after_write) {
+            closeConnection(connection);
+            return false;
+        }
+        return true;
+    }
+
+    void drainPosted() {
+        std::vector<PostedOutput> posted;
+        {
+            std::lock_guard<std::mutex> lock(posted_mutex_);
+            posted.swap(posted_);
+        }
+        for (auto& output : posted) {
+            auto it = connections_.find(output.fd);
+            if (it == connections_.end() || it->second.id != output.id) continue; // the client left
+            Connection& connection = it->second;
+            if (connection.output.empty()) connection.output.swap(output.bytes);
+            else connection.output += output.bytes;
+            connection.last_active = std::chrono::steady_clock::now();
+            if (output.last) {
+                connection.busy = false;
+                connection.close_after_write = connection.close_after_write || output.close;
+            }
+            if (!flush(connection)) continue;
+            // Pipelined requests wait in the input until the previous response is complete
+            if (output.last) processInput(connection);
+        }
+    }
+
+    void closeIdle(std::chrono::steady_clock::time_point now) {
+        std::vector<int> idle;
+        for (const auto& pair : connections_) {
+            const Connection& connection = pair.second;
+            if (!connection.busy && connection.output.empty() && now - connection.last_active > std::chrono::seconds(options_.keep_alive_seconds)) {
+                idle.push_back(pair.first);
+            }
+        }
+        for (int fd : idle) closeConnection(connections_.at(fd));
+    }
+
+    void closeConnection(Connection& connection) {
+        int fd = connection.fd;
+        connection.closed->store(true);
+        connection.hung_up->store(true);
+        ::close(fd);
+        connections_.erase(fd);
+    }
+
+    const EpollServer& server_;
+    WorkerPool& workers_;
+    const ListenerOptions& options_;
+    const std::atomic<bool>& stopping_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::unordered_map<int, Connection> connections_;
+    uint64_t next_id_ = 1;
+    std::mutex posted_mutex_;
+    std::vector<PostedOutput> posted_;
+};
+
+ResponseStream::~ResponseStream() {
+    if (!finished_) loop_->post({fd_, id_, "", true, true});
+}
+
+void ResponseStream::write(const std::string& data) {
+    if (data.empty() || finished_ || closed()) return;
+    loop_->post({fd_, id_, chunkBytes(data.data(), data.size()), false, false});
+}
+
+void ResponseStream::finish() {
+    if (finished_) return;
+    finished_ = true;
+    loop_->post({fd_, id_, "0\r\n\r\n", true, !keep_alive_});
+}
+
+EpollServer::EpollServer() {}
+
+EpollServer::~EpollServer() {}
+
+EpollServer& EpollServer::Get(const std::string& path, Handler handler) {
+    routes_[{"GET", path}].handler = std::move(handler);
+    return *this;
+}
+
+EpollServer& EpollServer::Post(const std::string& path, Handler handler) {
+    routes_[{"POST", path}].handler = std::move(handler);
+    return *this;
+}
+
+EpollServer& EpollServer::PostStreaming(const std::string& path, StreamingHandler handler) {
+    routes_[{"POST", path}].streaming = std::move(handler);
+    return *this;
+}
+
+void EpollServer::submit(std::function<void()> job) {
+    workers_->submit(std::move(job));
+}
+
+bool EpollServer::set_base_dir(const std::string& dir) {
+    struct stat info;
+    if (stat(dir.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) return false;
+    base_dir_ = dir;
+    while (base_dir_.size() > 1 && base_dir_.back() == '/') base_dir_.pop_back();
+    return true;
+}
+
+void EpollServer::dispatch(const httplib::Request& req, httplib::Response& res, const StreamOpener& open) const {
+    auto route = routes_.find({req.method, req.path});
+    if (route != routes_.end()) {
+        try {
+            if (route->second.streaming) route->second.streaming(req, res, open);
+            else route->second.handler(req, res);
+        } catch (const std::exception& e) {
+            LogLine(LOG_ERROR, "handler_failed").field("path", req.path).field("error", e.what());
+            res = httplib::Response();
+            res.status = 500;
+        }
+        return;
+    }
+
+    // Static files, as httplib::Server::set_base_dir serves them
+    std::string path = req.path.empty() || req.path.back() == '/' ? req.path + "index.html" : req.path;
+    if (req.method == "GET" && !base_dir_.empty() && httplib::detail::is_valid_path(path)) {
+        std::ifstream file(base_dir_ + path, std::ios::binary);
+        struct stat info;
+        if (file && stat((base_dir_ + path).c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+            std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            res.set_content(std::move(content), httplib::detail::find_content_type(path, {}, "application/octet-stream"));
+            res.status = 200;
+            return;
+        }
+    }
+    res.status = 404;
+}
+
+bool EpollServer::listen(const ListenerOptions& options) {
+    stopping_ = false;
+    int worker_count = options.workers > 0 ? options.workers : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    workers_.reset(new WorkerPool(worker_count));
+    for (int i = 0; i < std::max(1, options.listeners); ++i) {
+        std::unique_ptr<EventLoop> loop(new EventLoop(*this, *workers_, options, stopping_));
+        std::string error;
+        if (!loop->open(error)) {
+            LogLine(LOG_ERROR, "listen_failed").field("host", options.host).field("port", options.port).field("error", error);
+            loops_.clear();
+            workers_.reset();
+            return false;
+        }
+        loops_.push_back(std::move(loop));
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < loops_.size(); ++i) threads.emplace_back(&EventLoop::run, loops_[i].get());
+    loops_[0]->run();
+    for (auto& thread : threads) thread.join();
+    // Requests still queued are answered into the void before the loops' descriptors go away
+    workers_.reset();
+    loops_.clear();
+    return true;
+}
+
+void EpollServer::stop() {
+    stopping_ = true;
+    for (auto& loop : loops_) loop->wake();
+}
+
+#endif // __linux__
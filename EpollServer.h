@@ -0,0 +1,110 @@
+#ifndef EPOLLSERVER_H_INCLUDED
+#define EPOLLSERVER_H_INCLUDED
+
+#ifdef __linux__
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "httplib.h"
+
+// Settings of the Linux listener
+struct ListenerOptions {
+    std::string host = "localhost";
+    int port = 8080;
+    int listeners = 1;           // event loops, each accepting on its own SO_REUSEPORT socket
+    int workers = 0;             // threads running handlers; 0 means one per hardware thread
+    int backlog = 4096;          // accept queue length; the kernel caps it at net.core.somaxconn
+    bool tcp_nodelay = true;     // responses are written whole, so Nagle only adds delay
+    int keep_alive_seconds = 5;  // idle connections are closed after this long
+    size_t max_header_bytes = 64 * 1024;
+    size_t max_body_bytes = 4 * 1024 * 1024;
+};
+
+class EventLoop;
+class WorkerPool;
+
+// The body of a chunked response written after its handler has returned, from any thread.
+// Chunks go out in the order write() is called, so concurrent writers must serialize their
+// calls. A stream dropped without finish() closes the connection, the only way to tell the
+// client that the response is incomplete.
+class ResponseStream {
+public:
+    ResponseStream(EventLoop* loop, int fd, uint64_t id, bool keep_alive, std::shared_ptr<std::atomic<bool>> closed)
+        : loop_(loop), fd_(fd), id_(id), keep_alive_(keep_alive), closed_(std::move(closed)) {}
+    ~ResponseStream();
+    ResponseStream(const ResponseStream&) = delete;
+    ResponseStream& operator=(const ResponseStream&) = delete;
+
+    void write(const std::string& data);
+    // Ends the response; the connection moves on to its next request
+    void finish();
+    // The client has gone away; further writes are dropped
+    bool closed() const { return closed_->load(std::memory_order_relaxed); }
+
+private:
+    EventLoop* loop_;
+    int fd_;
+    uint64_t id_;
+    bool keep_alive_;
+    bool finished_ = false;
+    std::shared_ptr<std::atomic<bool>> closed_;
+};
+
+// Sends the status line and headers of a 200 chunked response and returns its stream
+typedef std::function<std::shared_ptr<ResponseStream>(const char* content_type)> StreamOpener;
+// Answers like a Handler, by filling the Response, or opens a stream and returns at once,
+// leaving the body to work it queued with EpollServer::submit
+typedef std::function<void(const httplib::Request&, httplib::Response&, const StreamOpener&)> StreamingHandler;
+
+// HTTP/1.1 server for Linux built on epoll. Event loops only move bytes: they accept
+// connections, read and parse requests, and write responses, so an idle keep-alive connection
+// costs a buffer rather than a thread. Parsed requests run on a fixed pool of worker threads,
+// using the same handler signature as httplib::Server, so routes can be registered on either.
+// Chunked responses are streamed to the client chunk by chunk as the handler produces them;
+// streaming handlers go further and hand their work to the pool instead of holding a worker.
+class EpollServer {
+public:
+    typedef httplib::Server::Handler Handler;
+
+    EpollServer();
+    ~EpollServer();
+
+    // Routes match the request path exactly
+    EpollServer& Get(const std::string& path, Handler handler);
+    EpollServer& Post(const std::string& path, Handler handler);
+    EpollServer& PostStreaming(const std::string& path, StreamingHandler handler);
+    // GET requests without a route are served from files under `dir`, as httplib::Server does
+    bool set_base_dir(const std::string& dir);
+
+    // Binds every listener and serves until stop() is called. Returns false if binding failed.
+    bool listen(const ListenerOptions& options);
+    void stop();
+
+    // Queues `job` for the worker pool, behind the requests already waiting. Only valid while
+    // listen() runs, e.g. from handlers.
+    void submit(std::function<void()> job);
+
+    // Runs the handler for `req`, or serves a file, or answers 404. Called on worker threads.
+    void dispatch(const httplib::Request& req, httplib::Response& res, const StreamOpener& open) const;
+
+private:
+    struct Route {
+        Handler handler;
+        StreamingHandler streaming; // set instead of `handler` for streaming routes
+    };
+
+    std::map<std::pair<std::string, std::string>, Route> routes_; // (method, path)
+    std::string base_dir_;
+    std::vector<std::unique_ptr<EventLoop>> loops_;
+    std::unique_ptr<WorkerPool> workers_;
+    std::atomic<bool> stopping_{false};
+};
+
+#endif // __linux__
+
+#endif // EPOLLSERVER_H_INCLUDED
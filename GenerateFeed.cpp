@@ -0,0 +1,323 @@
+// Synthetic GTFS feed generator for scaling tests. Writes agency, stops, routes, trips, stop_times,
+// calendar and transfers files for a made-up city of any size, so the engine and the benchmark can
+// be run on networks far larger than the Delhi feed. The same options and seed always produce the
+// same feed.
+//
+//     GenerateFeed <output dir> [--stops N] [--lines L] [--stops-per-line K] [--layout grid|radial|random]
+//                  [--spacing METERS] [--headway MIN] [--peak-headway MIN] [--transfer-radius METERS] [--seed S]
+//
+// Transfers connect stops within --transfer-radius of each other, by default 1.5 times --spacing.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// The city is laid out in meters around this point and converted to degrees on output
+const double CENTER_LAT = 28.6139;
+const double CENTER_LON = 77.2090;
+const double METERS_PER_DEGREE = 111320.0;
+const double PI = 3.14159265358979323846;
+
+// Service runs from 05:00 until the last departures at 24:00; peak headways apply 07-10 and 17-20
+const int SERVICE_START = 5 * 3600;
+const int SERVICE_END = 24 * 3600;
+// Added to the running time between stops; arrival and departure times are equal
+const int DWELL_SECONDS = 20;
+// Fare zones are rings of this width around the center
+const double ZONE_WIDTH_METERS = 5000;
+// Default transfer radius in stop spacings: wide enough to reach a stop's neighbors on any layout
+const double TRANSFER_RADIUS_SPACINGS = 1.5;
+
+struct FeedOptions {
+    std::string output_dir;
+    int stops = 1000;
+    int lines = 50;
+    int stops_per_line = 25;
+    std::string layout = "grid";
+    double spacing_meters = 400;
+    int headway_minutes = 12;
+    int peak_headway_minutes = 6;
+    double transfer_radius_meters = -1; // -1: TRANSFER_RADIUS_SPACINGS times the spacing
+    uint64_t seed = 1;
+};
+
+struct Point {
+    double x;
+    double y;
+};
+
+// Uniform in [0, 1); hand-rolled so that a seed gives the same feed with every standard library
+static double uniform(std::mt19937_64& rng) {
+    return (rng() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double distance(const Point& a, const Point& b) {
+    return std::hypot(a.x - b.x, a.y - b.y);
+}
+
+// Stops bucketed into square cells of the stop spacing, for nearest-stop lookups
+class StopGrid {
+public:
+    StopGrid(const std::vector<Point>& stops, double cell_size) : stops_(stops), cell_size_(cell_size) {
+        min_x_ = min_y_ = 1e18;
+        double max_x = -1e18, max_y = -1e18;
+        for (const auto& stop : stops) {
+            min_x_ = std::min(min_x_, stop.x);
+            min_y_ = std::min(min_y_, stop.y);
+            max_x = std::max(max_x, stop.x);
+            max_y = std::max(max_y, stop.y);
+        }
+        columns_ = static_cast<int>((max_x - min_x_) / cell_size_) + 1;
+        rows_ = static_cast<int>((max_y - min_y_) / cell_size_) + 1;
+        cells_.resize(static_cast<size_t>(columns_) * rows_);
+        for (size_t i = 0; i < stops.size(); ++i) cells_[cellOf(stops[i])].push_back(static_cast<int>(i));
+    }
+
+    // The stop nearest to `point` within `radius`, or -1
+    int nearest(const Point& point, double radius) const {
+        int best = -1;
+        double best_distance = radius;
+        forEachNear(point, radius, [&](int stop, double d) {
+            if (d <= best_distance) {
+                best = stop;
+                best_distance = d;
+            }
+        });
+        return best;
+    }
+
+    template <typename Visit>
+    void forEachNear(const Point& point, double radius, Visit visit) const {
+        int reach = static_cast<int>(radius / cell_size_) + 1;
+        int column = static_cast<int>((point.x - min_x_) / cell_size_);
+        int row = static_cast<int>((point.y - min_y_) / cell_size_);
+        for (int r = std::max(0, row - reach); r <= std::min(rows_ - 1, row + reach); ++r) {
+            for (int c = std::max(0, column - reach); c <= std::min(columns_ - 1, column + reach); ++c) {
+                for (int stop : cells_[static_cast<size_t>(r) * columns_ + c]) {
+                    double d = distance(point, stops_[stop]);
+                    if (d <= radius) visit(stop, d);
+                }
+            }
+        }
+    }
+
+private:
+    size_t cellOf(const Point& point) const {
+        int column = static_cast<int>((point.x - min_x_) / cell_size_);
+        int row = static_cast<int>((point.y - min_y_) / cell_size_);
+        return static_cast<size_t>(row) * columns_ + column;
+    }
+
+    const std::vector<Point>& stops_;
+    double cell_size_;
+    double min_x_, min_y_;
+    int columns_, rows_;
+    std::vector<std::vector<int>> cells_;
+};
+
+// grid: a square lattice. radial: rings around the center, each with room for more stops than
+// the one inside it. random: scattered uniformly over a square of the same density.
+static std::vector<Point> placeStops(const FeedOptions& options, std::mt19937_64& rng) {
+    std::vector<Point> stops;
+    const double spacing = options.spacing_meters;
+    if (options.layout == "radial") {
+        stops.push_back({0, 0});
+        for (int ring = 1; static_cast<int>(stops.size()) < options.stops; ++ring) {
+            int count = 6 * ring;
+            double offset = uniform(rng) * 2 * PI / count;
+            for (int i = 0; i < count && static_cast<int>(stops.size()) < options.stops; ++i) {
+                double angle = offset + 2 * PI * i / count;
+                stops.push_back({ring * spacing * std::cos(angle), ring * spacing * std::sin(angle)});
+            }
+        }
+        return stops;
+    }
+    int side = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(options.stops))));
+    double half = side * spacing / 2;
+    for (int i = 0; i < options.stops; ++i) {
+        if (options.layout == "random") stops.push_back({uniform(rng) * 2 * half - half, uniform(rng) * 2 * half - half});
+        else stops.push_back({(i % side) * spacing - half, (i / side) * spacing - half});
+    }
+    return stops;
+}
+
+// The points a line is drawn through, one stop spacing apart. Grid lines run along a row or a
+// column; radial lines cross the center or follow a ring; random lines run in any direction.
+static std::vector<Point> linePath(const FeedOptions& options, const std::vector<Point>& stops, std::mt19937_64& rng) {
+    const double spacing = options.spacing_meters;
+    const int length = options.stops_per_line;
+    std::vector<Point> path;
+    if (options.layout == "radial" && uniform(rng) < 0.3) {
+        // Orbital line along part of a ring
+        int rings = std::max(1, static_cast<int>(std::hypot(stops.back().x, stops.back().y) / spacing + 0.5));
+        double radius = (1 + static_cast<int>(rng() % rings)) * spacing;
+        double start = uniform(rng) * 2 * PI;
+        for (int i = 0; i < length; ++i) {
+            double angle = start + i * spacing / radius;
+            path.push_back({radius * std::cos(angle), radius * std::sin(angle)});
+        }
+        return path;
+    }
+    Point start;
+    double angle;
+    if (options.layout == "radial") {
+        // Through the center, from one side of the city to the other
+        angle = uniform(rng) * 2 * PI;
+        start = {-std::cos(angle) * spacing * length / 2, -std::sin(angle) * spacing * length / 2};
+    } else {
+        start = stops[rng() % stops.size()];
+        angle = options.layout == "grid" ? (rng() % 4) * PI / 2 : uniform(rng) * 2 * PI;
+    }
+    for (int i = 0; i < length; ++i) {
+        path.push_back({start.x + std::cos(angle) * spacing * i, start.y + std::sin(angle) * spacing * i});
+    }
+    return path;
+}
+
+static FILE* openOutput(const FeedOptions& options, const char* name, const char* header) {
+    std::string path = options.output_dir + name;
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) throw std::runtime_error("cannot write " + path);
+    fputs(header, file);
+    return file;
+}
+
+static void writeTime(FILE* file, int seconds) {
+    fprintf(file, "%02d:%02d:%02d", seconds / 3600, seconds / 60 % 60, seconds % 60);
+}
+
+static void generateFeed(const FeedOptions& options) {
+    std::mt19937_64 rng(options.seed);
+    std::vector<Point> stops = placeStops(options, rng);
+    StopGrid grid(stops, options.spacing_meters);
+
+    FILE* file = openOutput(options, "agency.txt", "agency_id,agency_name,agency_url,agency_timezone\n");
+    fputs("SYN,Synthetic Transit,https://example.com,Asia/Kolkata\n", file);
+    fclose(file);
+
+    file = openOutput(options, "calendar.txt", "service_id,monday,tuesday,wednesday,thursday,friday,saturday,sunday,start_date,end_date\n");
+    fputs("DAILY,1,1,1,1,1,1,1,20250101,20351231\n", file);
+    fclose(file);
+
+    file = openOutput(options, "stops.txt", "stop_id,stop_name,stop_lat,stop_lon,zone_id\n");
+    const double meters_per_lon_degree = METERS_PER_DEGREE * std::cos(CENTER_LAT * PI / 180);
+    for (size_t i = 0; i < stops.size(); ++i) {
+        int zone = static_cast<int>(std::hypot(stops[i].x, stops[i].y) / ZONE_WIDTH_METERS);
+        fprintf(file, "%zu,Stop %zu,%.6f,%.6f,Z%d\n", i + 1, i + 1, CENTER_LAT + stops[i].y / METERS_PER_DEGREE,
+                CENTER_LON + stops[i].x / meters_per_lon_degree, zone);
+    }
+    fclose(file);
+
+    // Walking transfers between every pair of stops within the radius, at 1.4 m/s plus a minute
+    file = openOutput(options, "transfers.txt", "from_stop_id,to_stop_id,transfer_type,min_transfer_time\n");
+    size_t transfers = 0;
+    for (size_t i = 0; i < stops.size(); ++i) {
+        grid.forEachNear(stops[i], options.transfer_radius_meters, [&](int other, double d) {
+            if (other == static_cast<int>(i)) return;
+            fprintf(file, "%zu,%d,2,%d\n", i + 1, other + 1, 60 + static_cast<int>(d / 1.4));
+            ++transfers;
+        });
+    }
+    fclose(file);
+
+    FILE* routes = openOutput(options, "routes.txt", "route_id,agency_id,route_short_name,route_long_name,route_type\n");
+    FILE* trips = openOutput(options, "trips.txt", "route_id,service_id,trip_id,direction_id\n");
+    FILE* stop_times = openOutput(options, "stop_times.txt", "trip_id,arrival_time,departure_time,stop_id,stop_sequence\n");
+    size_t trip_count = 0, stop_time_count = 0;
+    int line_count = 0;
+    for (int line = 1; line <= options.lines; ++line) {
+        // Snap the line's path to stops; paths that leave the city too early are drawn again
+        std::vector<int> line_stops;
+        for (int attempt = 0; attempt < 20 && line_stops.size() < 2; ++attempt) {
+            line_stops.clear();
+            for (const Point& point : linePath(options, stops, rng)) {
+                int stop = grid.nearest(point, options.spacing_meters * 0.75);
+                if (stop >= 0 && std::find(line_stops.begin(), line_stops.end(), stop) == line_stops.end()) line_stops.push_back(stop);
+            }
+        }
+        if (line_stops.size() < 2) continue;
+
+        fprintf(routes, "R%d,SYN,%d,Line %d,3\n", line, line, line);
+        ++line_count;
+        // Each line gets its own speed, 15-30 km/h, and its own offset within the headway
+        double speed_mps = (15 + uniform(rng) * 15) / 3.6;
+        std::vector<int> run_seconds(1, 0);
+        for (size_t i = 1; i < line_stops.size(); ++i) {
+            double d = distance(stops[line_stops[i - 1]], stops[line_stops[i]]);
+            run_seconds.push_back(run_seconds.back() + static_cast<int>(d / speed_mps) + DWELL_SECONDS);
+        }
+        for (int direction = 0; direction < 2; ++direction) {
+            int departure = SERVICE_START + static_cast<int>(rng() % (options.headway_minutes * 60));
+            for (int trip = 0; departure <= SERVICE_END; ++trip) {
+                fprintf(trips, "R%d,DAILY,R%d_%d_%d,%d\n", line, line, direction, trip, direction);
+                for (size_t i = 0; i < line_stops.size(); ++i) {
+                    size_t at = direction == 0 ? i : line_stops.size() - 1 - i;
+                    int arrival = departure + (direction == 0 ? run_seconds[at] : run_seconds.back() - run_seconds[at]);
+                    fprintf(stop_times, "R%d_%d_%d,", line, direction, trip);
+                    writeTime(stop_times, arrival);
+                    fputc(',', stop_times);
+                    writeTime(stop_times, arrival);
+                    fprintf(stop_times, ",%d,%zu\n", line_stops[at] + 1, i + 1);
+                    ++stop_time_count;
+                }
+                ++trip_count;
+                int hour = departure / 3600;
+                bool peak = (hour >= 7 && hour < 10) || (hour >= 17 && hour < 20);
+                departure += (peak ? options.peak_headway_minutes : options.headway_minutes) * 60;
+            }
+        }
+    }
+    fclose(routes);
+    fclose(trips);
+    fclose(stop_times);
+
+    fprintf(stderr, "%zu stops, %d lines, %zu trips, %zu stop times, %zu transfers written to %s\n",
+            stops.size(), line_count, trip_count, stop_time_count, transfers, options.output_dir.c_str());
+}
+
+static bool parseOptions(int argc, char** argv, FeedOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--stops" && has_value) options.stops = std::max(2, atoi(argv[++i]));
+        else if (arg == "--lines" && has_value) options.lines = std::max(1, atoi(argv[++i]));
+        else if (arg == "--stops-per-line" && has_value) options.stops_per_line = std::max(2, atoi(argv[++i]));
+        else if (arg == "--spacing" && has_value) options.spacing_meters = std::max(10.0, atof(argv[++i]));
+        else if (arg == "--headway" && has_value) options.headway_minutes = std::max(1, atoi(argv[++i]));
+        else if (arg == "--peak-headway" && has_value) options.peak_headway_minutes = std::max(1, atoi(argv[++i]));
+        else if (arg == "--transfer-radius" && has_value) options.transfer_radius_meters = std::max(0.0, atof(argv[++i]));
+        else if (arg == "--seed" && has_value) options.seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--layout" && has_value) {
+            options.layout = argv[++i];
+            if (options.layout != "grid" && options.layout != "radial" && options.layout != "random") return false;
+        } else if (arg[0] != '-' && options.output_dir.empty()) {
+            options.output_dir = arg;
+        } else {
+            return false;
+        }
+    }
+    return !options.output_dir.empty();
+}
+
+int main(int argc, char** argv) {
+    FeedOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "usage: %s <output dir> [--stops N] [--lines L] [--stops-per-line K] [--layout grid|radial|random]\n"
+                        "       [--spacing METERS] [--headway MIN] [--peak-headway MIN] [--transfer-radius METERS] [--seed S]\n", argv[0]);
+        return 2;
+    }
+    if (options.output_dir.back() != '/' && options.output_dir.back() != '\\') options.output_dir += '/';
+    if (options.transfer_radius_meters < 0) options.transfer_radius_meters = TRANSFER_RADIUS_SPACINGS * options.spacing_meters;
+    try {
+        generateFeed(options);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,236 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include "GtfsParser.h"
+
+#ifdef _WIN32
+// Without NOMINMAX, windows.h defines min and max macros that break std::min and std::max
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file != INVALID_HANDLE_VALUE) {
+        LARGE_INTEGER file_size;
+        if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping) {
+                void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(mapping);
+                if (view) {
+                    mapping_ = view;
+                    data_ = static_cast<const char*>(view);
+                    size_ = static_cast<size_t>(file_size.QuadPart);
+                    open_ = true;
+                }
+            }
+        }
+        CloseHandle(file);
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED) {
+                madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                mapping_ = view;
+                data_ = static_cast<const char*>(view);
+                size_ = static_cast<size_t>(st.st_size);
+                open_ = true;
+            }
+        }
+        ::close(fd);
+    }
+#endif
+    if (open_) return;
+
+    // Empty files can't be mapped, and some filesystems refuse to; fall back to a plain read
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return;
+    buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    open_ = true;
+}
+
+MappedFile::~MappedFile() {
+    if (!mapping_) return;
+#ifdef _WIN32
+    UnmapViewOfFile(mapping_);
+#else
+    munmap(mapping_, size_);
+#endif
+}
+
+const char* nextLine(const char* pos, const char* end) {
+    const char* newline = static_cast<const char*>(memchr(pos, '\n', static_cast<size_t>(end - pos)));
+    return newline ? newline + 1 : end;
+}
+
+int splitFields(const char* line, const char* line_end, FieldView* fields, int max_fields) {
+    if (line_end > line && line_end[-1] == '\r') --line_end;
+    int count = 0;
+    const char* pos = line;
+    while (count < max_fields) {
+        FieldView& field = fields[count++];
+        if (pos < line_end && *pos == '"') {
+            field.begin = ++pos;
+            while (pos < line_end && *pos != '"') ++pos;
+            field.end = pos;
+            while (pos < line_end && *pos != ',') ++pos;
+        } else {
+            field.begin = pos;
+            while (pos < line_end && *pos != ',') ++pos;
+            field.end = pos;
+        }
+        if (pos >= line_end) break;
+        ++pos; // skip ','
+    }
+    return count;
+}
+
+const char* CsvHeader::parse(const char* data, const char* end) {
+    const char* line_end = nextLine(data, end);
+    const char* content_end = (line_end > data && line_end[-1] == '\n') ? line_end - 1 : line_end;
+    if (content_end - data >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) data += 3; // UTF-8 BOM
+    std::vector<FieldView> fields(1 + std::count(data, content_end, ','));
+    int count = splitFields(data, content_end, fields.data(), static_cast<int>(fields.size()));
+    names_.clear();
+    for (int i = 0; i < count; ++i) {
+        const char* b = fields[i].begin;
+        const char* e = fields[i].end;
+        while (b < e && *b == ' ') ++b;
+        while (e > b && e[-1] == ' ') --e;
+        names_.emplace_back(b, e);
+    }
+    return line_end;
+}
+
+int CsvHeader::column(std::initializer_list<const char*> names) const {
+    for (const char* name : names) {
+        for (size_t i = 0; i < names_.size(); ++i) {
+            if (names_[i] == name) return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+int CsvHeader::requireColumn(const char* file, std::initializer_list<const char*> names) const {
+    int index = column(names);
+    if (index < 0) throw std::runtime_error(std::string(file) + " has no " + *names.begin() + " column");
+    return index;
+}
+
+void forEachRow(const char* begin, const char* end, int width,
+                const std::function<void(const FieldView*, int)>& fn) {
+    std::vector<FieldView> fields(std::max(1, width));
+    for (const char* line = begin; line < end; ) {
+        const char* line_end = nextLine(line, end);
+        const char* content_end = (line_end > line && line_end[-1] == '\n') ? line_end - 1 : line_end;
+        if (content_end > line && !(content_end - line == 1 && *line == '\r')) {
+            int count = splitFields(line, content_end, fields.data(), static_cast<int>(fields.size()));
+            fn(fields.data(), count);
+        }
+        line = line_end;
+    }
+}
+
+bool parseInt(const FieldView& field, int& out) {
+    const char* p = field.begin;
+    while (p < field.end && *p == ' ') ++p;
+    bool negative = false;
+    if (p < field.end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+    if (p == field.end) return false;
+    int value = 0;
+    for (; p < field.end; ++p) {
+        if (*p < '0' || *p > '9') {
+            if (*p == ' ') break;
+            return false;
+        }
+        value = value * 10 + (*p - '0');
+    }
+    out = negative ? -value : value;
+    return true;
+}
+
+bool parseDouble(const FieldView& field, double& out) {
+    char buffer[64];
+    size_t length = field.size();
+    if (length == 0 || length >= sizeof(buffer)) return false;
+    memcpy(buffer, field.begin, length);
+    buffer[length] = '\0';
+    char* parsed_end = nullptr;
+    out = strtod(buffer, &parsed_end);
+    return parsed_end != buffer;
+}
+
+bool parseTime(const FieldView& field, Time& out) {
+    // H:MM:SS or HH:MM:SS, hours may exceed 24 for after-midnight service
+    int parts[3] = {0, 0, 0};
+    int part = 0;
+    bool digit_seen = false;
+    const char* p = field.begin;
+    while (p < field.end && *p == ' ') ++p;
+    for (; p < field.end; ++p) {
+        if (*p >= '0' && *p <= '9') {
+            parts[part] = parts[part] * 10 + (*p - '0');
+            digit_seen = true;
+        } else if (*p == ':' && part < 2) {
+            ++part;
+        } else if (*p == ' ') {
+            break;
+        } else {
+            return false;
+        }
+    }
+    if (!digit_seen || part != 2) return false;
+    out.h = parts[0];
+    out.m = parts[1];
+    out.s = parts[2];
+    return true;
+}
+
+size_t forEachChunkParallel(const char* begin, const char* end,
+                            const std::function<void(size_t, const char*, const char*)>& fn) {
+    const size_t MIN_CHUNK_BYTES = 1 << 20;
+    size_t total = static_cast<size_t>(end - begin);
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t chunk_count = std::max<size_t>(1, std::min(threads, total / MIN_CHUNK_BYTES));
+
+    // Cut at roughly equal offsets, then move each cut forward to the next line start
+    std::vector<const char*> cuts;
+    cuts.push_back(begin);
+    for (size_t i = 1; i < chunk_count; ++i) {
+        const char* cut = std::max(begin + total * i / chunk_count, cuts.back());
+        cuts.push_back(cut < end ? nextLine(cut, end) : end);
+    }
+    cuts.push_back(end);
+
+    if (chunk_count == 1) {
+        fn(0, begin, end);
+        return 1;
+    }
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < chunk_count; ++i) {
+        workers.emplace_back(fn, i, cuts[i], cuts[i + 1]);
+    }
+    for (auto& worker : workers) worker.join();
+    return chunk_count;
+}
@@ -0,0 +1,80 @@
+#ifndef GTFSPARSER_H_INCLUDED
+#define GTFSPARSER_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include "DataTypes.h"
+
+// Read-only view of a whole file. Memory-mapped where the platform allows it, otherwise read
+// into a buffer once. The view is empty if the file could not be opened.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const { return open_; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    bool open_ = false;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    void* mapping_ = nullptr;   // platform mapping handle, null when buffered
+    std::vector<char> buffer_;  // fallback storage
+};
+
+// A field inside a mapped file; points into the file, never owns memory
+struct FieldView {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    size_t size() const { return static_cast<size_t>(end - begin); }
+    bool empty() const { return begin == end; }
+    std::string str() const { return std::string(begin, end); }
+};
+
+// Returns the position just past the end of the line starting at `pos` (past the '\n')
+const char* nextLine(const char* pos, const char* end);
+
+// Splits one CSV line (without its newline) into at most max_fields fields. Surrounding quotes
+// are stripped and commas inside quotes are kept. Returns the number of fields found.
+int splitFields(const char* line, const char* line_end, FieldView* fields, int max_fields);
+
+// Column layout of a GTFS file, resolved once from its header line so that rows can be parsed
+// by precomputed field index regardless of the column order a feed uses
+class CsvHeader {
+public:
+    // Reads the header line at `data`; returns the start of the first body line
+    const char* parse(const char* data, const char* end);
+
+    // Index of the first of the given column names present in the header, or -1
+    int column(std::initializer_list<const char*> names) const;
+    // Like column(), but throws std::runtime_error naming `file` if the column is absent
+    int requireColumn(const char* file, std::initializer_list<const char*> names) const;
+    int width() const { return static_cast<int>(names_.size()); }
+
+private:
+    std::vector<std::string> names_;
+};
+
+// Calls fn(fields, field_count) for every non-empty line in [begin, end). The field array holds
+// `width` entries and is reused between lines.
+void forEachRow(const char* begin, const char* end, int width,
+                const std::function<void(const FieldView*, int)>& fn);
+
+// Allocation-free conversions; return false on malformed input
+bool parseInt(const FieldView& field, int& out);
+bool parseDouble(const FieldView& field, double& out);
+bool parseTime(const FieldView& field, Time& out);
+
+// Splits the body of a file (from `begin`) into newline-aligned chunks and calls
+// fn(chunk_index, chunk_begin, chunk_end) for each on its own thread. Returns the chunk count.
+size_t forEachChunkParallel(const char* begin, const char* end,
+                            const std::function<void(size_t, const char*, const char*)>& fn);
+
+#endif // GTFSPARSER_H_INCLUDED
@@ -0,0 +1,146 @@
+#include <cstdlib>
+#include <cstring>
+#include "JsonReader.h"
+
+void JsonReader::skipWhitespace() {
+    while (pos_ < end_ && (*pos_ == ' ' || *pos_ == '\t' || *pos_ == '\n' || *pos_ == '\r')) ++pos_;
+}
+
+bool JsonReader::consume(char c) {
+    skipWhitespace();
+    if (pos_ == end_ || *pos_ != c) return false;
+    ++pos_;
+    return true;
+}
+
+bool JsonReader::atEnd() {
+    skipWhitespace();
+    return pos_ == end_;
+}
+
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static void appendUtf8(std::string& out, unsigned code) {
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xC0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += static_cast<char>(0xE0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+}
+
+bool JsonReader::readString(std::string& out) {
+    skipWhitespace();
+    if (pos_ == end_ || *pos_ != '"') return false;
+    const char* p = pos_ + 1;
+    std::string value;
+    while (p < end_ && *p != '"') {
+        if (*p != '\\') {
+            value += *p++;
+            continue;
+        }
+        if (++p == end_) return false;
+        switch (*p++) {
+            case '"': value += '"'; break;
+            case '\\': value += '\\'; break;
+            case '/': value += '/'; break;
+            case 'b': value += '\b'; break;
+            case 'f': value += '\f'; break;
+            case 'n': value += '\n'; break;
+            case 'r': value += '\r'; break;
+            case 't': value += '\t'; break;
+            case 'u': {
+                unsigned code = 0;
+                for (int i = 0; i < 4; ++i) {
+                    int digit = p < end_ ? hexDigit(*p++) : -1;
+                    if (digit < 0) return false;
+                    code = code * 16 + digit;
+                }
+                // A high surrogate followed by \uDC00-\uDFFF is one code point
+                if (code >= 0xD800 && code < 0xDC00 && end_ - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                    unsigned low = 0;
+                    bool valid = true;
+                    for (int i = 2; i < 6 && valid; ++i) {
+                        int digit = hexDigit(p[i]);
+                        valid = digit >= 0;
+                        low = low * 16 + digit;
+                    }
+                    if (valid && low >= 0xDC00 && low < 0xE000) {
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        p += 6;
+                    }
+                }
+                appendUtf8(value, code);
+                break;
+            }
+            default: return false;
+        }
+    }
+    if (p == end_) return false;
+    pos_ = p + 1;
+    out.swap(value);
+    return true;
+}
+
+bool JsonReader::readNumber(double& out) {
+    skipWhitespace();
+    if (pos_ == end_ || !(*pos_ == '-' || (*pos_ >= '0' && *pos_ <= '9'))) return false;
+    // strtod needs a terminated buffer; numbers are short, so copy the token
+    const char* p = pos_;
+    while (p < end_ && (strchr("+-.eE", *p) != nullptr || (*p >= '0' && *p <= '9'))) ++p;
+    std::string token(pos_, p);
+    char* parsed_end = nullptr;
+    double value = strtod(token.c_str(), &parsed_end);
+    if (parsed_end != token.c_str() + token.size()) return false;
+    pos_ = p;
+    out = value;
+    return true;
+}
+
+bool JsonReader::skipValue(int depth) {
+    skipWhitespace();
+    if (pos_ == end_) return false;
+    std::string ignored;
+    double number;
+    switch (*pos_) {
+        case '"': return readString(ignored);
+        case '{':
+        case '[': {
+            if (depth == MAX_JSON_DEPTH) return false;
+            char close = *pos_ == '{' ? '}' : ']';
+            ++pos_;
+            if (consume(close)) return true;
+            do {
+                if (close == '}' && !(readString(ignored) && consume(':'))) return false;
+                if (!skipValue(depth + 1)) return false;
+            } while (consume(','));
+            return consume(close);
+        }
+        case 't': case 'f': case 'n': {
+            const char* words[] = {"true", "false", "null"};
+            for (const char* word : words) {
+                size_t length = strlen(word);
+                if (static_cast<size_t>(end_ - pos_) >= length && memcmp(pos_, word, length) == 0) {
+                    pos_ += length;
+                    return true;
+                }
+            }
+            return false;
+        }
+        default: return readNumber(number);
+    }
+}
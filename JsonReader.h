@@ -0,0 +1,38 @@
+#ifndef JSONREADER_H_INCLUDED
+#define JSONREADER_H_INCLUDED
+
+#include <string>
+
+// Deepest nesting skipValue accepts; request bodies never need more, and the limit keeps a
+// hostile body from exhausting the stack
+const int MAX_JSON_DEPTH = 32;
+
+// Minimal pull parser for request bodies: the caller walks the document it expects token by
+// token and skips members it does not know. Every method skips leading whitespace and returns
+// false, without consuming anything else, if the next token is not what was asked for.
+class JsonReader {
+public:
+    JsonReader(const char* begin, const char* end) : pos_(begin), end_(end) {}
+    explicit JsonReader(const std::string& text) : JsonReader(text.data(), text.data() + text.size()) {}
+    // The reader points into the text, so a temporary would leave it dangling
+    JsonReader(std::string&&) = delete;
+
+    // Consumes the structural character `c` ({ } [ ] : ,) if it is next
+    bool consume(char c);
+    // Reads a string value, resolving escapes (\uXXXX becomes UTF-8)
+    bool readString(std::string& out);
+    bool readNumber(double& out);
+    // Skips one value of any type, including nested objects and arrays up to MAX_JSON_DEPTH deep
+    bool skipValue() { return skipValue(0); }
+    // True once only whitespace is left
+    bool atEnd();
+
+private:
+    void skipWhitespace();
+    bool skipValue(int depth);
+
+    const char* pos_;
+    const char* end_;
+};
+
+#endif // JSONREADER_H_INCLUDED
@@ -0,0 +1,99 @@
+#include <cmath>
+#include <cstdio>
+#include "JsonWriter.h"
+
+void JsonWriter::separate() {
+    if (after_key_) {
+        after_key_ = false;
+        return;
+    }
+    if (depth_ == 0) return;
+    uint64_t bit = uint64_t(1) << (depth_ - 1);
+    if (has_elements_ & bit) out_ += ',';
+    has_elements_ |= bit;
+}
+
+void JsonWriter::open(char bracket) {
+    separate();
+    out_ += bracket;
+    ++depth_;
+    has_elements_ &= ~(uint64_t(1) << (depth_ - 1));
+}
+
+void JsonWriter::close(char bracket) {
+    --depth_;
+    out_ += bracket;
+}
+
+void JsonWriter::writeString(const char* text, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+    out_ += '"';
+    // Runs of characters that need no escaping are appended in one go
+    const char* run = text;
+    const char* end = text + length;
+    for (const char* p = text; p < end; ++p) {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        out_.append(run, p);
+        run = p + 1;
+        switch (c) {
+            case '"': out_ += "\\\""; break;
+            case '\\': out_ += "\\\\"; break;
+            case '\n': out_ += "\\n"; break;
+            case '\r': out_ += "\\r"; break;
+            case '\t': out_ += "\\t"; break;
+            case '\b': out_ += "\\b"; break;
+            case '\f': out_ += "\\f"; break;
+            default: {
+                char escaped[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+                out_.append(escaped, 6);
+            }
+        }
+    }
+    out_.append(run, end);
+    out_ += '"';
+}
+
+void JsonWriter::writeInteger(int64_t value) {
+    char digits[20];
+    int count = 0;
+    // Negate in unsigned arithmetic so INT64_MIN works too
+    uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    do {
+        digits[count++] = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0) out_ += '-';
+    while (count > 0) out_ += digits[--count];
+}
+
+JsonWriter& JsonWriter::number(double value) {
+    if (!std::isfinite(value)) return null();
+    separate();
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "%.9g", value);
+    out_.append(buffer, length);
+    return *this;
+}
+
+JsonWriter& JsonWriter::time(const Time& value) {
+    separate();
+    char buffer[24];
+    char* p = buffer + sizeof(buffer);
+    *--p = '"';
+    int parts[2] = {value.s, value.m};
+    for (int part : parts) {
+        *--p = static_cast<char>('0' + part % 10);
+        *--p = static_cast<char>('0' + part / 10 % 10);
+        *--p = ':';
+    }
+    int hours = value.h;
+    do {
+        *--p = static_cast<char>('0' + hours % 10);
+        hours /= 10;
+    } while (hours != 0 && p > buffer + 1);
+    if (value.h < 10) *--p = '0';
+    *--p = '"';
+    out_.append(p, buffer + sizeof(buffer) - p);
+    return *this;
+}
@@ -0,0 +1,50 @@
+#ifndef JSONWRITER_H_INCLUDED
+#define JSONWRITER_H_INCLUDED
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include "DataTypes.h"
+
+// Streaming JSON writer that appends to a caller-owned string, e.g. the body of a response.
+// Commas between members and array elements are inserted automatically and string values are
+// escaped. Numbers and times are formatted by hand into stack buffers, so nothing is allocated
+// beyond the output string's own growth. Nesting is limited to 64 levels.
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) : out_(out) {}
+
+    JsonWriter& beginObject() { open('{'); return *this; }
+    JsonWriter& endObject() { close('}'); return *this; }
+    JsonWriter& beginArray() { open('['); return *this; }
+    JsonWriter& endArray() { close(']'); return *this; }
+
+    // Member name inside an object; the next call writes its value
+    JsonWriter& key(const char* name) { separate(); writeString(name, strlen(name)); out_ += ':'; after_key_ = true; return *this; }
+
+    JsonWriter& string(const char* text, size_t length) { separate(); writeString(text, length); return *this; }
+    JsonWriter& string(const char* text) { return string(text, strlen(text)); }
+    JsonWriter& string(const std::string& text) { return string(text.data(), text.size()); }
+    JsonWriter& number(int64_t value) { separate(); writeInteger(value); return *this; }
+    JsonWriter& number(int value) { return number(static_cast<int64_t>(value)); }
+    JsonWriter& number(double value); // non-finite values are written as null
+    JsonWriter& boolean(bool value) { separate(); out_ += value ? "true" : "false"; return *this; }
+    JsonWriter& null() { separate(); out_ += "null"; return *this; }
+    // "HH:MM:SS"; hours keep counting past 24 for times on the next service day
+    JsonWriter& time(const Time& value);
+
+private:
+    void separate();
+    void open(char bracket);
+    void close(char bracket);
+    void writeString(const char* text, size_t length);
+    void writeInteger(int64_t value);
+
+    std::string& out_;
+    uint64_t has_elements_ = 0; // bit d: the container at depth d already holds an element
+    int depth_ = 0;
+    bool after_key_ = false;
+};
+
+#endif // JSONWRITER_H_INCLUDED
@@ -0,0 +1,441 @@
+// HTTP load generator: replays a query log against a running server over many keep-alive
+// connections and reports latency percentiles, throughput and error rates as JSON on stdout.
+// With --verify it also runs every query through the engine in-process beforehand and checks
+// each response against that result.
+//
+//     LoadTest <query log> [--host H] [--port P] [--connections N] [--rate R] [--requests N]
+//              [--max_connections N] [--verify <feed dir>] [server limits]
+//
+// Without --rate it runs closed-loop: N connections, each sending its next request as soon as
+// the previous one is answered. With --rate it runs open-loop: request i is sent at i / R
+// seconds whether or not earlier ones have been answered, on an idle connection or, when all
+// are busy, on a new one (up to --max_connections). Latency counts from the scheduled time.
+//
+// The reference run uses the server's limits, so --verify needs them too: either the server's
+// --config file or the same --rounds, --max_rounds, --walk_meters, --max_walk_meters,
+// --walking_speed_mps and --max_horizon_hours flags. Each query's own rounds, walk and horizon
+// parameters are applied within them as the server does. A response marked partial (cut short
+// by budget_ms or the server's time budget) is counted but not compared.
+//
+// The log holds one query per line, either as the part of a /api/route URL after the '?'
+// ("from=1&to=5&time=07:50:00&criteria=walking") or as a line of the server's own log, whose
+// event=route lines carry from, to and time fields. Blank lines and lines starting with '#' are
+// skipped. The log is replayed from the start as often as needed to send --requests queries.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "httplib.h"
+#include "Config.h"
+#include "DataTypes.h"
+#include "Raptor.h"
+#include "Timetable.h"
+#include "JsonReader.h"
+#include "JsonWriter.h"
+
+struct LoadOptions {
+    std::string log_path;
+    std::string host = "localhost";
+    int port = 8080;
+    int connections = 16;     // closed loop: all of them; open loop: opened up front
+    int max_connections = 1024; // open loop
+    double rate = 0; // requests per second over all connections; 0 sends as fast as possible
+    int requests = 0; // 0: every line of the log once
+    std::string verify_dir;
+    ServerConfig server; // limits of the server under test, for the reference run
+};
+
+// The parts of a journey a response and the reference run must agree on
+struct JourneyKey {
+    int departure;
+    int arrival;
+    int trips;
+    int walk_meters;
+    int fare;
+
+    bool operator<(const JourneyKey& other) const {
+        if (departure != other.departure) return departure < other.departure;
+        if (arrival != other.arrival) return arrival < other.arrival;
+        if (trips != other.trips) return trips < other.trips;
+        if (walk_meters != other.walk_meters) return walk_meters < other.walk_meters;
+        return fare < other.fare;
+    }
+    bool operator==(const JourneyKey& other) const {
+        return !(*this < other) && !(other < *this);
+    }
+};
+
+struct LoggedQuery {
+    std::string path; // "/api/route?..."
+    std::map<std::string, std::string> params;
+    bool unknown_stop = false;       // reference: the server must answer 400 with an error object
+    std::vector<JourneyKey> expected; // reference: sorted journeys
+};
+
+// Outcome of one request
+struct RequestSample {
+    int64_t micros = 0;  // from the scheduled send time, so a server falling behind shows up
+    bool transport_error = false;
+    int status = 0;
+    bool partial = false;
+    bool mismatch = false;
+    bool late = false;   // open loop: sent more than a millisecond after its scheduled time
+};
+
+static std::string percentDecode(const std::string& text) {
+    std::string decoded;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '%' && i + 2 < text.size()) {
+            decoded += static_cast<char>(strtol(text.substr(i + 1, 2).c_str(), nullptr, 16));
+            i += 2;
+        } else {
+            decoded += text[i] == '+' ? ' ' : text[i];
+        }
+    }
+    return decoded;
+}
+
+// Reads one log line into a query; false for lines that hold none
+static bool parseLogLine(const std::string& line, LoggedQuery& query) {
+    if (line.empty() || line[0] == '#') return false;
+    std::string query_string;
+    if (line.find("event=route") != std::string::npos) {
+        // A server log line: take the unquoted from, to and time fields
+        std::stringstream fields(line);
+        std::string field;
+        while (fields >> field) {
+            size_t equals = field.find('=');
+            if (equals == std::string::npos) continue;
+            std::string key = field.substr(0, equals);
+            if (key == "from" || key == "to" || key == "time") {
+                query_string += (query_string.empty() ? "" : "&") + field;
+            }
+        }
+    } else {
+        query_string = line.substr(line.find('?') == std::string::npos ? 0 : line.find('?') + 1);
+        while (!query_string.empty() && (query_string.back() == '\r' || query_string.back() == ' ')) query_string.pop_back();
+    }
+    std::stringstream pairs(query_string);
+    std::string pair;
+    while (std::getline(pairs, pair, '&')) {
+        size_t equals = pair.find('=');
+        if (equals != std::string::npos) query.params[pair.substr(0, equals)] = percentDecode(pair.substr(equals + 1));
+    }
+    if (!query.params.count("from") || !query.params.count("to") || !query.params.count("time")) return false;
+    query.path = "/api/route?" + query_string;
+    return true;
+}
+
+static int paramInt(const LoggedQuery& query, const char* name, int fallback) {
+    auto it = query.params.find(name);
+    return it == query.params.end() ? fallback : atoi(it->second.c_str());
+}
+
+static double paramDouble(const LoggedQuery& query, const char* name, double fallback) {
+    auto it = query.params.find(name);
+    return it == query.params.end() ? fallback : atof(it->second.c_str());
+}
+
+// Runs the query the way /api/route does and keeps its journeys as the expected answer. Budgets
+// are left out: a complete reference is only compared with complete responses.
+static void computeReference(LoggedQuery& query, const Timetable& timetable, const ServerConfig& server) {
+    int from = paramInt(query, "from", -1);
+    int to = paramInt(query, "to", -1);
+    if (!timetable.stops.count(from) || !timetable.stops.count(to)) {
+        query.unknown_stop = true;
+        return;
+    }
+    RaptorCriteria criteria;
+    auto criteria_it = query.params.find("criteria");
+    if (criteria_it != query.params.end()) {
+        criteria.walking = criteria_it->second.find("walking") != std::string::npos;
+        criteria.fare = criteria_it->second.find("fare") != std::string::npos;
+    }
+    int horizon_seconds = DEFAULT_HORIZON_SECONDS;
+    if (query.params.count("horizon")) {
+        horizon_seconds = std::max(1, std::min(paramInt(query, "horizon", 0), server.max_horizon_hours)) * 3600;
+    }
+    RaptorLimits limits = queryLimits(server, paramInt(query, "rounds", -1), paramDouble(query, "walk", -1));
+
+    std::map<int, std::vector<Journey>> final_profiles;
+    RoundLabels labels;
+    runMultiCriteriaRaptor(from, to, Time(query.params.at("time")), timetable, final_profiles, labels, horizon_seconds, criteria,
+                           nullptr, limits);
+    if (final_profiles.count(to)) {
+        for (const auto& journey : final_profiles.at(to)) {
+            // Like the server, price the legs: the search only does so for the fare criterion
+            int fare = 0;
+            for (const auto& leg : reconstructLegs(journey, labels, timetable)) fare += leg.fare;
+            query.expected.push_back({journey.departure_time.toSeconds(), journey.arrival_time.toSeconds(), journey.trips, journey.walk_meters, fare});
+        }
+    }
+    std::sort(query.expected.begin(), query.expected.end());
+}
+
+// "HH:MM:SS" to seconds; hours may exceed 24
+static int parseClock(const std::string& text) {
+    int h = 0, m = 0, s = 0;
+    sscanf(text.c_str(), "%d:%d:%d", &h, &m, &s);
+    return h * 3600 + m * 60 + s;
+}
+
+// True if a /api/route response body carries exactly the expected journeys. Sets `partial` if
+// the server marked it so; the journeys are not compared then.
+static bool responseMatches(const std::string& body, const LoggedQuery& query, bool& partial) {
+    JsonReader reader(body);
+    std::vector<JourneyKey> found;
+    bool has_error = false;
+    partial = false;
+    if (!reader.consume('{')) return false;
+    do {
+        std::string key;
+        if (!reader.readString(key) || !reader.consume(':')) return false;
+        if (key == "error") {
+            has_error = true;
+            if (!reader.skipValue()) return false;
+        } else if (key == "results") {
+            if (!reader.consume('[')) return false;
+            if (reader.consume(']')) continue;
+            do {
+                JourneyKey journey = {};
+                if (!reader.consume('{')) return false;
+                do {
+                    std::string field, text;
+                    double number;
+                    if (!reader.readString(field) || !reader.consume(':')) return false;
+                    if (field == "departure_time" && reader.readString(text)) journey.departure = parseClock(text);
+                    else if (field == "arrival_time" && reader.readString(text)) journey.arrival = parseClock(text);
+                    else if (field == "trips" && reader.readNumber(number)) journey.trips = static_cast<int>(number);
+                    else if (field == "walk_meters" && reader.readNumber(number)) journey.walk_meters = static_cast<int>(number);
+                    else if (field == "fare" && reader.readNumber(number)) journey.fare = static_cast<int>(number);
+                    else if (!reader.skipValue()) return false;
+                } while (reader.consume(','));
+                if (!reader.consume('}')) return false;
+                found.push_back(journey);
+            } while (reader.consume(','));
+            if (!reader.consume(']')) return false;
+        } else if (key == "partial") {
+            // Only ever written as "partial": true
+            partial = true;
+            return true;
+        } else if (!reader.skipValue()) {
+            return false;
+        }
+    } while (reader.consume(','));
+    if (query.unknown_stop) return has_error;
+    std::sort(found.begin(), found.end());
+    return !has_error && found == query.expected;
+}
+
+static int64_t percentile(const std::vector<int64_t>& sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(fraction * sorted.size() + 0.999999);
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+// Reads the options; throws std::runtime_error for a server config file that can't be used
+static bool parseOptions(int argc, char** argv, LoadOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        ServerConfig& server = options.server;
+        if (arg == "--host" && has_value) options.host = argv[++i];
+        else if (arg == "--port" && has_value) options.port = atoi(argv[++i]);
+        else if (arg == "--connections" && has_value) options.connections = std::max(1, atoi(argv[++i]));
+        else if (arg == "--max_connections" && has_value) options.max_connections = std::max(1, atoi(argv[++i]));
+        else if (arg == "--rate" && has_value) options.rate = std::max(0.0, atof(argv[++i]));
+        else if (arg == "--requests" && has_value) options.requests = std::max(0, atoi(argv[++i]));
+        else if (arg == "--verify" && has_value) options.verify_dir = argv[++i];
+        // The server's limits, under the server's own names
+        else if (arg == "--config" && has_value) loadConfigFile(argv[++i], server);
+        else if (arg == "--rounds" && has_value) server.rounds = atoi(argv[++i]);
+        else if (arg == "--max_rounds" && has_value) server.max_rounds = atoi(argv[++i]);
+        else if (arg == "--walk_meters" && has_value) server.walk_meters = atof(argv[++i]);
+        else if (arg == "--max_walk_meters" && has_value) server.max_walk_meters = atof(argv[++i]);
+        else if (arg == "--walking_speed_mps" && has_value) server.walking_speed_mps = atof(argv[++i]);
+        else if (arg == "--max_horizon_hours" && has_value) server.max_horizon_hours = atoi(argv[++i]);
+        else if (arg[0] != '-' && options.log_path.empty()) options.log_path = arg;
+        else return false;
+    }
+    options.max_connections = std::max(options.max_connections, options.connections);
+    return !options.log_path.empty();
+}
+
+int main(int argc, char** argv) {
+    LoadOptions options;
+    bool usable;
+    try {
+        usable = parseOptions(argc, argv, options);
+        validateConfig(options.server);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+    if (!usable) {
+        fprintf(stderr, "usage: %s <query log> [--host H] [--port P] [--connections N] [--rate R] [--requests N]\n"
+                        "       [--max_connections N] [--verify <feed dir>] [--config <server config>]\n"
+                        "       [--rounds N] [--max_rounds N] [--walk_meters M] [--max_walk_meters M]\n"
+                        "       [--walking_speed_mps S] [--max_horizon_hours H]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<LoggedQuery> log;
+    std::ifstream log_file(options.log_path);
+    if (!log_file) {
+        fprintf(stderr, "cannot open %s\n", options.log_path.c_str());
+        return 1;
+    }
+    for (std::string line; std::getline(log_file, line);) {
+        LoggedQuery query;
+        if (parseLogLine(line, query)) log.push_back(query);
+    }
+    if (log.empty()) {
+        fprintf(stderr, "%s holds no route queries\n", options.log_path.c_str());
+        return 1;
+    }
+    size_t total = options.requests > 0 ? static_cast<size_t>(options.requests) : log.size();
+
+    // References are computed before the run, so verifying takes no CPU from the server under test
+    const bool verify = !options.verify_dir.empty();
+    if (verify) {
+        try {
+            auto timetable = loadTimetable(options.verify_dir, 1);
+            for (auto& query : log) computeReference(query, *timetable, options.server);
+        } catch (const std::exception& e) {
+            fprintf(stderr, "Failed to load GTFS data: %s\n", e.what());
+            return 1;
+        }
+    }
+
+    std::vector<RequestSample> samples(total);
+    auto started = std::chrono::steady_clock::now();
+    auto scheduledTime = [&](size_t i) {
+        return started + std::chrono::microseconds(static_cast<int64_t>(i * 1e6 / options.rate));
+    };
+    auto send = [&](httplib::Client& client, size_t i, std::chrono::steady_clock::time_point scheduled) {
+        const LoggedQuery& query = log[i % log.size()];
+        RequestSample& sample = samples[i];
+        sample.late = options.rate > 0 && std::chrono::steady_clock::now() - scheduled > std::chrono::milliseconds(1);
+        auto result = client.Get(query.path);
+        sample.micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - scheduled).count();
+        if (!result) {
+            sample.transport_error = true;
+            return;
+        }
+        sample.status = result->status;
+        // Unknown stops are answered with 400 and an error object
+        const int expected_status = verify && query.unknown_stop ? 400 : 200;
+        if (verify && result->status == expected_status) sample.mismatch = !responseMatches(result->body, query, sample.partial);
+    };
+
+    std::vector<std::thread> connections;
+    if (options.rate <= 0) {
+        // Closed loop: every connection sends its next request once the last one is answered
+        std::atomic<size_t> next_request{0};
+        for (int c = 0; c < options.connections; ++c) {
+            connections.emplace_back([&]() {
+                httplib::Client client(options.host, options.port);
+                client.set_keep_alive(true);
+                for (size_t i = next_request++; i < total; i = next_request++) send(client, i, std::chrono::steady_clock::now());
+            });
+        }
+    } else {
+        // Open loop: this thread hands out each request when it is due. Connections wait for
+        // work; when none is idle, a new one is opened so the request still leaves on time.
+        std::mutex mutex;
+        std::condition_variable work_ready;
+        std::deque<size_t> due;
+        int idle = 0;
+        bool all_sent = false;
+        auto connection = [&]() {
+            httplib::Client client(options.host, options.port);
+            client.set_keep_alive(true);
+            for (;;) {
+                size_t i;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ++idle;
+                    work_ready.wait(lock, [&] { return !due.empty() || all_sent; });
+                    --idle;
+                    if (due.empty()) return;
+                    i = due.front();
+                    due.pop_front();
+                }
+                send(client, i, scheduledTime(i));
+            }
+        };
+        for (int c = 0; c < options.connections; ++c) connections.emplace_back(connection);
+        for (size_t i = 0; i < total; ++i) {
+            std::this_thread::sleep_until(scheduledTime(i));
+            std::lock_guard<std::mutex> lock(mutex);
+            due.push_back(i);
+            if (static_cast<size_t>(idle) < due.size() && connections.size() < static_cast<size_t>(options.max_connections)) {
+                connections.emplace_back(connection);
+            }
+            work_ready.notify_one();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            all_sent = true;
+        }
+        work_ready.notify_all();
+    }
+    for (auto& connection : connections) connection.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    std::vector<int64_t> latencies;
+    size_t transport_errors = 0, http_errors = 0, mismatches = 0, partial = 0, late = 0;
+    for (size_t i = 0; i < total; ++i) {
+        const RequestSample& sample = samples[i];
+        if (sample.late) ++late;
+        if (sample.transport_error) {
+            ++transport_errors;
+            continue;
+        }
+        latencies.push_back(sample.micros);
+        const bool expect_error = verify && log[i % log.size()].unknown_stop;
+        if (sample.status != (expect_error ? 400 : 200)) ++http_errors;
+        if (sample.partial) ++partial;
+        if (sample.mismatch) ++mismatches;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    std::string report;
+    JsonWriter json(report);
+    json.beginObject()
+        .key("target").string(options.host + ":" + std::to_string(options.port))
+        .key("mode").string(options.rate > 0 ? "open_loop" : "closed_loop")
+        .key("log_queries").number(static_cast<int64_t>(log.size()))
+        .key("requests").number(static_cast<int64_t>(total))
+        .key("connections").number(static_cast<int64_t>(connections.size()))
+        .key("target_rate").number(options.rate)
+        .key("seconds").number(seconds)
+        .key("requests_per_second").number(total / seconds)
+        .key("latency_us").beginObject()
+            .key("p50").number(percentile(latencies, 0.50))
+            .key("p95").number(percentile(latencies, 0.95))
+            .key("p99").number(percentile(latencies, 0.99))
+            .key("p999").number(percentile(latencies, 0.999))
+            .key("max").number(latencies.empty() ? 0 : latencies.back())
+        .endObject()
+        .key("transport_errors").number(static_cast<int64_t>(transport_errors))
+        .key("http_errors").number(static_cast<int64_t>(http_errors))
+        .key("error_rate").number(static_cast<double>(transport_errors + http_errors) / total);
+    // Sent late because --max_connections were all busy; the rate was not held
+    if (options.rate > 0) json.key("late_sends").number(static_cast<int64_t>(late));
+    if (verify) json.key("partial_responses").number(static_cast<int64_t>(partial)).key("mismatches").number(static_cast<int64_t>(mismatches));
+    json.endObject();
+    printf("%s\n", report.c_str());
+    return transport_errors + http_errors + mismatches == 0 ? 0 : 3;
+}
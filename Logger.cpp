@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <thread>
+#include "Logger.h"
+
+// A ring slot. `sequence` says whose turn it is: equal to the slot's position for the next writer,
+// position + 1 once a line is in it for the reader (the bounded queue of D. Vyukov).
+struct LogSlot {
+    std::atomic<size_t> sequence;
+    int64_t unix_micros;
+    LogLevel level;
+    size_t length;
+    char text[LOG_LINE_BYTES];
+};
+
+static std::unique_ptr<LogSlot[]> ring;
+static std::atomic<size_t> enqueue_position{0};
+static size_t dequeue_position = 0; // only the writer thread moves it
+static std::atomic<uint64_t> dropped_lines{0};
+static std::atomic<uint64_t> request_ids{0};
+static std::atomic<bool> running{false};
+static std::atomic<bool> stopping{false};
+static std::thread writer;
+static LogLevel min_log_level = LOG_INFO;
+static int sample_rate = 1;
+
+static const char* const LEVEL_NAMES[] = {"debug", "info", "warn", "error"};
+
+static int64_t unixMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Writes "ts=2026-01-31T08:15:00.123Z level=info " followed by the line
+static void writeLine(FILE* out, int64_t unix_micros, LogLevel level, const char* text, size_t length) {
+    time_t seconds = static_cast<time_t>(unix_micros / 1000000);
+    struct tm utc;
+#ifdef _WIN32
+    gmtime_s(&utc, &seconds);
+#else
+    gmtime_r(&seconds, &utc);
+#endif
+    fprintf(out, "ts=%04d-%02d-%02dT%02d:%02d:%02d.%03dZ level=%s ", utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday,
+            utc.tm_hour, utc.tm_min, utc.tm_sec, static_cast<int>(unix_micros / 1000 % 1000), LEVEL_NAMES[level]);
+    fwrite(text, 1, length, out);
+    fputc('\n', out);
+}
+
+// Takes the oldest queued line, if any, and writes it
+static bool writeNext() {
+    LogSlot& slot = ring[dequeue_position % LOG_RING_SIZE];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeue_position + 1) return false;
+    writeLine(stdout, slot.unix_micros, slot.level, slot.text, slot.length);
+    slot.sequence.store(dequeue_position + LOG_RING_SIZE, std::memory_order_release);
+    ++dequeue_position;
+    return true;
+}
+
+static void reportDropped() {
+    uint64_t dropped = dropped_lines.exchange(0);
+    if (dropped == 0) return;
+    char text[64];
+    int length = snprintf(text, sizeof(text), "event=log_dropped lines=%llu", static_cast<unsigned long long>(dropped));
+    writeLine(stdout, unixMicros(), LOG_WARN, text, length);
+}
+
+// The terminal is only flushed once the ring is empty, so a burst costs one write
+static void writerLoop() {
+    for (;;) {
+        bool wrote = false;
+        while (writeNext()) wrote = true;
+        reportDropped();
+        if (wrote) fflush(stdout);
+        else if (stopping.load()) break;
+        else std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    fflush(stdout);
+}
+
+void startLogging(LogLevel min_level, int sample_every) {
+    if (running.load()) return;
+    min_log_level = min_level;
+    sample_rate = std::max(1, sample_every);
+    ring.reset(new LogSlot[LOG_RING_SIZE]);
+    for (size_t i = 0; i < LOG_RING_SIZE; ++i) ring[i].sequence.store(i, std::memory_order_relaxed);
+    enqueue_position.store(0);
+    dequeue_position = 0;
+    stopping.store(false);
+    writer = std::thread(writerLoop);
+    running.store(true);
+}
+
+void stopLogging() {
+    if (!running.exchange(false)) return;
+    stopping.store(true);
+    writer.join();
+}
+
+bool logEnabled(LogLevel level) {
+    return level >= min_log_level;
+}
+
+bool logSampled() {
+    // Counted per thread, so sampling never touches a shared cache line
+    thread_local unsigned calls = 0;
+    return ++calls % sample_rate == 0;
+}
+
+uint64_t nextRequestId() {
+    return request_ids.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+LogLine::LogLine(LogLevel level, const char* event) : level_(level), enabled_(logEnabled(level)) {
+    if (!enabled_) return;
+    append("event=", 6);
+    append(event, strlen(event));
+}
+
+LogLine::~LogLine() {
+    if (!enabled_) return;
+    if (!running.load(std::memory_order_acquire)) {
+        // Before startLogging (or in tools that never call it) lines are written directly
+        writeLine(stdout, unixMicros(), level_, text_, length_);
+        fflush(stdout);
+        return;
+    }
+    size_t position = enqueue_position.load(std::memory_order_relaxed);
+    for (;;) {
+        LogSlot& slot = ring[position % LOG_RING_SIZE];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == position) {
+            if (!enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) continue;
+            slot.unix_micros = unixMicros();
+            slot.level = level_;
+            slot.length = length_;
+            memcpy(slot.text, text_, length_);
+            slot.sequence.store(position + 1, std::memory_order_release);
+            return;
+        }
+        if (sequence < position) {
+            // The writer has not freed this slot yet: the ring is full
+            dropped_lines.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        position = enqueue_position.load(std::memory_order_relaxed);
+    }
+}
+
+void LogLine::append(const char* text, size_t length) {
+    length = std::min(length, LOG_LINE_BYTES - length_);
+    memcpy(text_ + length_, text, length);
+    length_ += length;
+}
+
+void LogLine::appendKey(const char* key) {
+    append(" ", 1);
+    append(key, strlen(key));
+    append("=", 1);
+}
+
+LogLine& LogLine::field(const char* key, const char* value) {
+    if (!enabled_) return *this;
+    appendKey(key);
+    size_t length = strlen(value);
+    bool quote = length == 0;
+    for (size_t i = 0; i < length && !quote; ++i) {
+        unsigned char c = value[i];
+        quote = c <= ' ' || c == '"' || c == '=' || c == '\\';
+    }
+    if (!quote) {
+        append(value, length);
+        return *this;
+    }
+    append("\"", 1);
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char c = value[i];
+        if (c == '"' || c == '\\') {
+            char escaped[2] = {'\\', static_cast<char>(c)};
+            append(escaped, 2);
+        } else if (c < ' ') {
+            char escaped[8];
+            int escaped_length = snprintf(escaped, sizeof(escaped), "\\x%02x", c);
+            append(escaped, escaped_length);
+        } else {
+            append(value + i, 1);
+        }
+    }
+    append("\"", 1);
+    return *this;
+}
+
+LogLine& LogLine::field(const char* key, int64_t value) {
+    if (!enabled_) return *this;
+    appendKey(key);
+    char number[24];
+    int length = snprintf(number, sizeof(number), "%lld", static_cast<long long>(value));
+    append(number, length);
+    return *this;
+}
+
+LogLine& LogLine::field(const char* key, uint64_t value) {
+    if (!enabled_) return *this;
+    appendKey(key);
+    char number[24];
+    int length = snprintf(number, sizeof(number), "%llu", static_cast<unsigned long long>(value));
+    append(number, length);
+    return *this;
+}
+
+LogLine& LogLine::field(const char* key, const Time& value) {
+    if (!enabled_) return *this;
+    appendKey(key);
+    char time[16];
+    int length = snprintf(time, sizeof(time), "%02d:%02d:%02d", value.h, value.m, value.s);
+    append(time, length);
+    return *this;
+}
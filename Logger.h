@@ -0,0 +1,67 @@
+#ifndef LOGGER_H_INCLUDED
+#define LOGGER_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "DataTypes.h"
+
+// Asynchronous structured logging. A line is formatted on the calling thread into a fixed-size
+// buffer and handed to a lock-free ring; a background thread timestamps and writes the lines in
+// logfmt (key=value) form to stdout. Callers never block on the terminal: if the ring is full the
+// line is dropped and counted, and the writer reports how many were lost.
+
+enum LogLevel {
+    LOG_DEBUG,
+    LOG_INFO,
+    LOG_WARN,
+    LOG_ERROR
+};
+
+// Longest line kept, including the level and event; longer lines are cut
+const size_t LOG_LINE_BYTES = 400;
+// Lines the ring can hold before callers start dropping them
+const size_t LOG_RING_SIZE = 4096;
+
+// Starts the writer thread. Lines below `min_level` are discarded where they are built, and
+// only one in `sample_every` sampled lines (see logSampled) is kept.
+void startLogging(LogLevel min_level, int sample_every = 1);
+// Writes out every queued line and stops the writer thread
+void stopLogging();
+
+bool logEnabled(LogLevel level);
+// True for one call in every `sample_every`; per-request lines use it so that busy servers can
+// log a fraction of their traffic
+bool logSampled();
+// Process-wide sequence number that ties a request's log lines together
+uint64_t nextRequestId();
+
+// One log line, queued when it goes out of scope:
+//     LogLine(LOG_INFO, "route").field("from", from).field("latency_us", micros);
+// Every method is a no-op if the level is disabled.
+class LogLine {
+public:
+    LogLine(LogLevel level, const char* event);
+    ~LogLine();
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+    // Strings are quoted and escaped when they contain spaces, quotes or control characters
+    LogLine& field(const char* key, const char* value);
+    LogLine& field(const char* key, const std::string& value) { return field(key, value.c_str()); }
+    LogLine& field(const char* key, int64_t value);
+    LogLine& field(const char* key, uint64_t value);
+    LogLine& field(const char* key, int value) { return field(key, static_cast<int64_t>(value)); }
+    LogLine& field(const char* key, const Time& value);
+
+private:
+    void append(const char* text, size_t length);
+    void appendKey(const char* key);
+
+    LogLevel level_;
+    bool enabled_;
+    size_t length_ = 0;
+    char text_[LOG_LINE_BYTES];
+};
+
+#endif // LOGGER_H_INCLUDED
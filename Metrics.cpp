@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdarg>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdio>
+#include "Metrics.h"
+
+struct MetricsShard {
+    std::atomic<uint64_t> counters[COUNTER_COUNT];
+    std::atomic<uint64_t> requests[ENDPOINT_COUNT];
+    std::atomic<uint64_t> errors[ENDPOINT_COUNT];
+    std::atomic<uint64_t> latency_sum_us[ENDPOINT_COUNT];
+    std::atomic<uint64_t> latency[ENDPOINT_COUNT][LATENCY_BUCKETS];
+
+    MetricsShard() {
+        for (auto& value : counters) value.store(0, std::memory_order_relaxed);
+        for (int e = 0; e < ENDPOINT_COUNT; ++e) {
+            requests[e].store(0, std::memory_order_relaxed);
+            errors[e].store(0, std::memory_order_relaxed);
+            latency_sum_us[e].store(0, std::memory_order_relaxed);
+            for (auto& value : latency[e]) value.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+// Shards are never freed; the registry mutex is only taken when a thread starts or ends
+static std::mutex registry_mutex;
+static std::vector<std::unique_ptr<MetricsShard>> all_shards;
+static std::vector<MetricsShard*> free_shards;
+
+struct ShardLease {
+    MetricsShard* shard;
+
+    ShardLease() {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        if (!free_shards.empty()) {
+            shard = free_shards.back();
+            free_shards.pop_back();
+        } else {
+            all_shards.emplace_back(new MetricsShard());
+            shard = all_shards.back().get();
+        }
+    }
+    ~ShardLease() {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        free_shards.push_back(shard);
+    }
+};
+
+static MetricsShard& localShard() {
+    thread_local ShardLease lease;
+    return *lease.shard;
+}
+
+// Only the owning thread writes a shard, so a relaxed load and store replace a locked add
+static void bump(std::atomic<uint64_t>& value, uint64_t amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+int latencyBucket(uint64_t micros) {
+    if (micros < 16) return static_cast<int>(micros);
+    int exponent = 63 - __builtin_clzll(micros);
+    if (exponent > 40) return LATENCY_BUCKETS - 1;
+    int sub_bucket = static_cast<int>((micros >> (exponent - 3)) & 7);
+    return 16 + (exponent - 4) * 8 + sub_bucket;
+}
+
+uint64_t latencyBucketUpperBound(int bucket) {
+    if (bucket < 16) return static_cast<uint64_t>(bucket);
+    int exponent = (bucket - 16) / 8 + 4;
+    uint64_t sub_bucket = (bucket - 16) % 8;
+    return ((8 + sub_bucket + 1) << (exponent - 3)) - 1;
+}
+
+void countMetric(MetricCounter counter, uint64_t amount) {
+    bump(localShard().counters[counter], amount);
+}
+
+void recordRequest(MetricEndpoint endpoint, int status, uint64_t micros) {
+    MetricsShard& shard = localShard();
+    bump(shard.requests[endpoint], 1);
+    if (status >= 400) bump(shard.errors[endpoint], 1);
+    bump(shard.latency_sum_us[endpoint], micros);
+    bump(shard.latency[endpoint][latencyBucket(micros)], 1);
+}
+
+static const char* const ENDPOINT_PATHS[ENDPOINT_COUNT] = {
+    "/api/stops", "/api/route", "/api/route/batch", "/api/profile", "/admin/reload", "/admin/status", "/admin/memory", "/metrics"
+};
+
+static const char* const COUNTER_NAMES[COUNTER_COUNT][2] = {
+    {"tp_engine_queries_total", "Route searches run"},
+    {"tp_engine_rounds_total", "RAPTOR rounds executed"},
+    {"tp_engine_patterns_scanned_total", "Route pattern scans"},
+    {"tp_engine_labels_created_total", "Labels kept by route searches"},
+    {"tp_engine_partial_results_total", "Searches stopped early by their deadline or cancellation"},
+};
+
+// Prometheus histogram boundaries in seconds; HDR buckets are assigned by their upper bound
+static const double EXPORTED_BOUNDS[] = {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10};
+static const double EXPORTED_QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+static void appendLine(std::string& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+static void appendLine(std::string& out, const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length > 0) out.append(line, std::min<size_t>(length, sizeof(line) - 1));
+}
+
+std::string renderMetrics() {
+    // Sum every shard; a shard being written concurrently may be a few events behind
+    uint64_t counters[COUNTER_COUNT] = {};
+    std::vector<uint64_t> requests(ENDPOINT_COUNT), errors(ENDPOINT_COUNT), latency_sum(ENDPOINT_COUNT);
+    std::vector<std::vector<uint64_t>> latency(ENDPOINT_COUNT, std::vector<uint64_t>(LATENCY_BUCKETS));
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        for (const auto& shard : all_shards) {
+            for (int c = 0; c < COUNTER_COUNT; ++c) counters[c] += shard->counters[c].load(std::memory_order_relaxed);
+            for (int e = 0; e < ENDPOINT_COUNT; ++e) {
+                requests[e] += shard->requests[e].load(std::memory_order_relaxed);
+                errors[e] += shard->errors[e].load(std::memory_order_relaxed);
+                latency_sum[e] += shard->latency_sum_us[e].load(std::memory_order_relaxed);
+                for (int b = 0; b < LATENCY_BUCKETS; ++b) latency[e][b] += shard->latency[e][b].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::string out;
+    out += "# HELP tp_requests_total HTTP requests handled\n# TYPE tp_requests_total counter\n";
+    for (int e = 0; e < ENDPOINT_COUNT; ++e) {
+        appendLine(out, "tp_requests_total{endpoint=\"%s\"} %llu\n", ENDPOINT_PATHS[e], static_cast<unsigned long long>(requests[e]));
+    }
+    out += "# HELP tp_request_errors_total HTTP requests answered with status 400 or above\n# TYPE tp_request_errors_total counter\n";
+    for (int e = 0; e < ENDPOINT_COUNT; ++e) {
+        appendLine(out, "tp_request_errors_total{endpoint=\"%s\"} %llu\n", ENDPOINT_PATHS[e], static_cast<unsigned long long>(errors[e]));
+    }
+
+    out += "# HELP tp_request_duration_seconds Time to handle a request\n# TYPE tp_request_duration_seconds histogram\n";
+    for (int e = 0; e < ENDPOINT_COUNT; ++e) {
+        int bucket = 0;
+        uint64_t cumulative = 0;
+        uint64_t total = 0;
+        for (uint64_t count : latency[e]) total += count;
+        for (double bound : EXPORTED_BOUNDS) {
+            uint64_t bound_us = static_cast<uint64_t>(bound * 1e6 + 0.5);
+            for (; bucket < LATENCY_BUCKETS && latencyBucketUpperBound(bucket) <= bound_us; ++bucket) cumulative += latency[e][bucket];
+            appendLine(out, "tp_request_duration_seconds_bucket{endpoint=\"%s\",le=\"%g\"} %llu\n", ENDPOINT_PATHS[e], bound, static_cast<unsigned long long>(cumulative));
+        }
+        appendLine(out, "tp_request_duration_seconds_bucket{endpoint=\"%s\",le=\"+Inf\"} %llu\n", ENDPOINT_PATHS[e], static_cast<unsigned long long>(total));
+        appendLine(out, "tp_request_duration_seconds_sum{endpoint=\"%s\"} %.6f\n", ENDPOINT_PATHS[e], latency_sum[e] / 1e6);
+        appendLine(out, "tp_request_duration_seconds_count{endpoint=\"%s\"} %llu\n", ENDPOINT_PATHS[e], static_cast<unsigned long long>(total));
+    }
+
+    // Quantiles straight from the fine-grained buckets, reported as each bucket's upper bound
+    out += "# HELP tp_request_duration_quantile_seconds Request latency quantiles since start\n# TYPE tp_request_duration_quantile_seconds gauge\n";
+    for (int e = 0; e < ENDPOINT_COUNT; ++e) {
+        uint64_t total = 0;
+        for (uint64_t count : latency[e]) total += count;
+        if (total == 0) continue;
+        for (double quantile : EXPORTED_QUANTILES) {
+            uint64_t rank = static_cast<uint64_t>(quantile * total + 0.5);
+            if (rank == 0) rank = 1;
+            uint64_t seen = 0;
+            int bucket = 0;
+            for (; bucket < LATENCY_BUCKETS - 1; ++bucket) {
+                seen += latency[e][bucket];
+                if (seen >= rank) break;
+            }
+            appendLine(out, "tp_request_duration_quantile_seconds{endpoint=\"%s\",quantile=\"%g\"} %.6f\n", ENDPOINT_PATHS[e], quantile, latencyBucketUpperBound(bucket) / 1e6);
+        }
+    }
+
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        appendLine(out, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", COUNTER_NAMES[c][0], COUNTER_NAMES[c][1], COUNTER_NAMES[c][0], COUNTER_NAMES[c][0],
+                   static_cast<unsigned long long>(counters[c]));
+    }
+    return out;
+}
@@ -0,0 +1,47 @@
+#ifndef METRICS_H_INCLUDED
+#define METRICS_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+
+// Process-wide counters and per-endpoint latency histograms, exported in the Prometheus text
+// format. Every thread updates its own shard with plain relaxed stores, so recording never
+// contends; rendering sums the shards. Shards of finished threads are handed to new threads,
+// keeping their counts.
+
+enum MetricCounter {
+    COUNTER_ENGINE_QUERIES,
+    COUNTER_ENGINE_ROUNDS,
+    COUNTER_PATTERNS_SCANNED,
+    COUNTER_LABELS_CREATED,
+    COUNTER_PARTIAL_RESULTS,
+    COUNTER_COUNT
+};
+
+enum MetricEndpoint {
+    ENDPOINT_STOPS,
+    ENDPOINT_ROUTE,
+    ENDPOINT_ROUTE_BATCH,
+    ENDPOINT_PROFILE,
+    ENDPOINT_ADMIN_RELOAD,
+    ENDPOINT_ADMIN_STATUS,
+    ENDPOINT_ADMIN_MEMORY,
+    ENDPOINT_METRICS,
+    ENDPOINT_COUNT
+};
+
+// Latencies go into log-linear buckets: exact below 16 us, then 8 buckets per power of two
+// (at most 12.5% relative error), up to 2^40 us
+const int LATENCY_BUCKETS = 16 + 37 * 8;
+
+int latencyBucket(uint64_t micros);
+// Largest latency, in microseconds, that falls into `bucket`
+uint64_t latencyBucketUpperBound(int bucket);
+
+void countMetric(MetricCounter counter, uint64_t amount = 1);
+void recordRequest(MetricEndpoint endpoint, int status, uint64_t micros);
+
+// All metrics in the Prometheus text exposition format
+std::string renderMetrics();
+
+#endif // METRICS_H_INCLUDED
@@ -0,0 +1,97 @@
+#ifndef PARETOBAG_H_INCLUDED
+#define PARETOBAG_H_INCLUDED
+
+#include <vector>
+#include <cstdint>
+#include "DataTypes.h"
+
+// Optional Pareto criteria on top of arrival time and number of trips
+struct RaptorCriteria {
+    bool walking = false; // total walking meters
+    bool fare = false;    // total fare
+    bool any() const { return walking || fare; }
+};
+
+// Compact search label: plain seconds instead of Time, so comparisons are single integer compares.
+// A search stores every label it keeps in a per-round array (the round is always `trips`); `parent`
+// points at the label this one extends, which makes path reconstruction a plain backtrack.
+struct Label {
+    int32_t arrival;              // seconds from the query day's midnight; may pass 24:00:00
+    int32_t departure;
+    int32_t walk_meters;
+    int32_t fare;
+    int32_t stop_id;              // where this label arrives
+    int32_t pattern;              // METHOD_TRIP: the ridden pattern and the trip within it; -1 otherwise
+    int32_t trip;
+    int32_t board;                // METHOD_TRIP: the pattern positions where the trip was boarded and left
+    int32_t alight;
+    int32_t parent;               // index in round parentRound(); -1 for the origin
+    int32_t index;                // own index in round `trips`
+    int16_t trips;
+    uint8_t method;               // JourneyMethod
+
+    // A trip leg extends a label from the previous round; walks stay in the same round
+    int parentRound() const { return method == METHOD_TRIP ? trips - 1 : trips; }
+};
+
+inline bool dominates(const Label& a, const Label& b, const RaptorCriteria& criteria) {
+    return a.arrival <= b.arrival && a.trips <= b.trips &&
+           (!criteria.walking || a.walk_meters <= b.walk_meters) &&
+           (!criteria.fare || a.fare <= b.fare);
+}
+
+// Set of mutually non-dominated labels, kept sorted by (arrival, trips). Only labels sorting at or
+// before a new one can dominate it and only those at or after it can be dominated by it, so an
+// insert reads the front part once, compacts the back part in place and never allocates once the
+// bag has grown to its working size.
+class ParetoBag {
+public:
+    typedef std::vector<Label>::const_iterator const_iterator;
+
+    // Returns false (and leaves the bag unchanged) if an existing label dominates `label`
+    bool insert(const Label& label, const RaptorCriteria& criteria) {
+        size_t count = labels_.size();
+        size_t position = 0;
+        while (position < count && sortsBefore(labels_[position], label)) {
+            if (dominates(labels_[position], label, criteria)) return false;
+            ++position;
+        }
+        // Labels equal on (arrival, trips) can still dominate the new one on the extra criteria
+        for (size_t i = position; i < count && !sortsBefore(label, labels_[i]); ++i) {
+            if (dominates(labels_[i], label, criteria)) return false;
+        }
+
+        size_t kept = position;
+        for (size_t i = position; i < count; ++i) {
+            if (!dominates(label, labels_[i], criteria)) labels_[kept++] = labels_[i];
+        }
+        labels_.resize(kept);
+        labels_.insert(labels_.begin() + position, label);
+        return true;
+    }
+
+    // True if some label in the bag dominates `label`
+    bool dominated(const Label& label, const RaptorCriteria& criteria) const {
+        for (const Label& existing : labels_) {
+            if (existing.arrival > label.arrival) break;
+            if (dominates(existing, label, criteria)) return true;
+        }
+        return false;
+    }
+
+    bool empty() const { return labels_.empty(); }
+    size_t size() const { return labels_.size(); }
+    const Label& front() const { return labels_.front(); } // earliest arrival
+    const_iterator begin() const { return labels_.begin(); }
+    const_iterator end() const { return labels_.end(); }
+    void clear() { labels_.clear(); }
+
+private:
+    static bool sortsBefore(const Label& a, const Label& b) {
+        return a.arrival < b.arrival || (a.arrival == b.arrival && a.trips < b.trips);
+    }
+
+    std::vector<Label> labels_;
+};
+
+#endif // PARETOBAG_H_INCLUDED
@@ -0,0 +1,237 @@
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include "Raptor.h"
+#include "Timetable.h"
+#include "SimdKernels.h"
+
+// Per-stop label storage for a profile query: one int32 arrival per departure time ("lane"),
+// stored stop-major so a stop's lanes are contiguous for the vector kernels
+struct LaneArrivals {
+    int lanes;
+    std::vector<int32_t> values;
+
+    LaneArrivals(int stop_slots, int lane_count) : lanes(lane_count), values(static_cast<size_t>(stop_slots) * lane_count, UNREACHED) {}
+    int32_t* at(int stop_id) { return values.data() + static_cast<size_t>(stop_id) * lanes; }
+    const int32_t* at(int stop_id) const { return values.data() + static_cast<size_t>(stop_id) * lanes; }
+    void reset() { std::fill(values.begin(), values.end(), UNREACHED); }
+};
+
+// Keeps only the lanes of `candidate` that beat `best`, then min-merges them into `target`.
+// Returns true if `target` improved in any lane.
+static bool relaxLanes(int32_t* target, int32_t* candidate, const int32_t* best, int lanes) {
+    for (int d = 0; d < lanes; ++d) {
+        if (candidate[d] >= best[d]) candidate[d] = UNREACHED;
+    }
+    return minMergeArrivals(target, candidate, lanes);
+}
+
+bool runProfileRaptor(int start_stop_id, int end_stop_id, const std::vector<Time>& departure_times,
+                      const Timetable& timetable,
+                      std::vector<ProfileJourney>& results,
+                      int horizon_seconds,
+                      const RaptorLimits& limits) {
+
+    const auto& stops = timetable.stops;
+    const int lanes = std::min<int>(static_cast<int>(departure_times.size()), MAX_PROFILE_DEPARTURES);
+    if (lanes == 0) return true;
+    const int stop_slots = timetable.stop_id_limit;
+
+    // Each lane has its own window; patterns are scanned for the union of them
+    std::vector<int32_t> lane_start(lanes), lane_end(lanes);
+    for (int d = 0; d < lanes; ++d) {
+        lane_start[d] = departure_times[d].toSeconds();
+        lane_end[d] = lane_start[d] + horizon_seconds;
+    }
+    const int window_start = *std::min_element(lane_start.begin(), lane_start.end());
+    const int window_end = *std::max_element(lane_end.begin(), lane_end.end());
+
+    // A stop reached on foot is not walked on from, so trip arrivals only have to beat the earlier
+    // trip arrivals there (`trip_best`) to be walked on from; `trip_round` holds this round's.
+    // Only the ones that also beat `best` are boarded from next round.
+    LaneArrivals best(stop_slots, lanes), round_arrival(stop_slots, lanes), previous_arrival(stop_slots, lanes);
+    LaneArrivals trip_best(stop_slots, lanes), trip_round(stop_slots, lanes);
+    std::vector<char> marked(stop_slots, 0), previously_marked(stop_slots, 0), trip_marked(stop_slots, 0);
+    std::vector<int> marked_stops, previous_stops, trip_stops;
+    std::vector<int32_t> candidate(lanes);
+    auto mark = [&](int stop_id) {
+        if (!marked[stop_id]) {
+            marked[stop_id] = 1;
+            marked_stops.push_back(stop_id);
+        }
+    };
+
+    // Walking legs at either end, computed once and shared by every lane
+    const Stop& start_stop_details = stops.at(start_stop_id);
+    const Stop& end_stop_details = stops.at(end_stop_id);
+    std::vector<int32_t> nearby(stop_slots);
+    std::vector<std::pair<int, int>> walks_to_end; // (stop id, walk seconds)
+    walks_to_end.push_back({end_stop_id, 0});
+    int nearby_count = end_stop_details.has_location
+        ? filterNearbyStops(end_stop_details.lat, end_stop_details.lon, timetable.stop_lats.data(), timetable.stop_lons.data(), stop_slots, limits.max_walk_meters, nearby.data())
+        : 0;
+    for (int i = 0; i < nearby_count; ++i) {
+        auto stop_it = stops.find(nearby[i]);
+        if (stop_it == stops.end() || stop_it->first == end_stop_id) continue;
+        double distance = haversine(stop_it->second.lat, stop_it->second.lon, end_stop_details.lat, end_stop_details.lon);
+        if (distance <= limits.max_walk_meters) walks_to_end.push_back({stop_it->first, static_cast<int>(distance / limits.walking_speed_mps)});
+    }
+
+    // Round 0: Initialize
+    std::copy(lane_start.begin(), lane_start.end(), round_arrival.at(start_stop_id));
+    mark(start_stop_id);
+    nearby_count = start_stop_details.has_location
+        ? filterNearbyStops(start_stop_details.lat, start_stop_details.lon, timetable.stop_lats.data(), timetable.stop_lons.data(), stop_slots, limits.max_walk_meters, nearby.data())
+        : 0;
+    for (int i = 0; i < nearby_count; ++i) {
+        auto stop_it = stops.find(nearby[i]);
+        if (stop_it == stops.end() || stop_it->first == start_stop_id) continue;
+        double distance = haversine(start_stop_details.lat, start_stop_details.lon, stop_it->second.lat, stop_it->second.lon);
+        if (distance > limits.max_walk_meters) continue;
+        int walk_duration_seconds = static_cast<int>(distance / limits.walking_speed_mps);
+        for (int d = 0; d < lanes; ++d) candidate[d] = lane_start[d] + walk_duration_seconds;
+        minMergeArrivals(round_arrival.at(stop_it->first), candidate.data(), lanes);
+        mark(stop_it->first);
+    }
+    auto start_transfers = timetable.transfers_map.find(start_stop_id);
+    if (start_transfers != timetable.transfers_map.end()) {
+        for (const auto& transfer : start_transfers->second) {
+            for (int d = 0; d < lanes; ++d) candidate[d] = lane_start[d] + transfer.duration_seconds;
+            minMergeArrivals(round_arrival.at(transfer.to_stop_id), candidate.data(), lanes);
+            mark(transfer.to_stop_id);
+        }
+    }
+    best.values = round_arrival.values;
+    // The origin was walked on from above, as if a trip had arrived there
+    std::copy(lane_start.begin(), lane_start.end(), trip_best.at(start_stop_id));
+
+    // The destination's best arrival per lane so far; a round adds an option only where it beats it
+    std::vector<int32_t> destination_best(lanes, UNREACHED);
+    std::vector<std::vector<ProfileJourney>> lane_results(lanes);
+    auto recordDestination = [&](int k) {
+        for (int d = 0; d < lanes; ++d) {
+            int32_t arrival = UNREACHED;
+            for (const auto& walk : walks_to_end) {
+                int32_t reached = round_arrival.at(walk.first)[d];
+                if (reached != UNREACHED) arrival = std::min(arrival, reached + walk.second);
+            }
+            if (arrival < destination_best[d]) {
+                destination_best[d] = arrival;
+                lane_results[d].push_back({departure_times[d], Time::fromSeconds(arrival), k});
+            }
+        }
+    };
+    recordDestination(0);
+
+    // RAPTOR Rounds
+    std::vector<int> queue_position(timetable.patterns.size(), -1);
+    std::vector<int> queued_patterns;
+    std::vector<int> trip(lanes), shift(lanes);
+    // A stopped search still records what the current round reached so far
+    const bool bounded = limits.bounded();
+    bool stopped = false;
+    int scans_until_check = CANCELLATION_CHECK_INTERVAL;
+    for (int k = 1; k <= limits.max_trips && !marked_stops.empty(); ++k) {
+        if (bounded && limits.expired()) {
+            stopped = true;
+            break;
+        }
+        previous_arrival.values.swap(round_arrival.values);
+        round_arrival.reset();
+        previous_stops.swap(marked_stops);
+        marked_stops.clear();
+        for (int stop_id : previous_stops) {
+            marked[stop_id] = 0;
+            previously_marked[stop_id] = 1;
+        }
+
+        // Every pattern serving a stop reached last round is scanned once, from the earliest such stop
+        for (int stop_id : previous_stops) {
+            auto serving = timetable.patterns_serving_stop.find(stop_id);
+            if (serving == timetable.patterns_serving_stop.end()) continue;
+            for (const auto& pattern_stop : serving->second) {
+                int& position = queue_position[pattern_stop.pattern];
+                if (position == -1) queued_patterns.push_back(pattern_stop.pattern);
+                if (position == -1 || pattern_stop.position < position) position = pattern_stop.position;
+            }
+        }
+
+        for (int pattern_index : queued_patterns) {
+            if (bounded && --scans_until_check == 0) {
+                scans_until_check = CANCELLATION_CHECK_INTERVAL;
+                if (limits.expired()) {
+                    stopped = true;
+                    break;
+                }
+            }
+            const RoutePattern& pattern = timetable.patterns[pattern_index];
+            int first_day, last_day;
+            pattern.serviceDays(window_start, window_end, first_day, last_day);
+            std::fill(trip.begin(), trip.end(), -1);
+
+            for (int position = queue_position[pattern_index]; position < pattern.stopCount(); ++position) {
+                int stop_id = pattern.stops[position];
+
+                // Arrivals of every lane's current trip at this stop, relaxed in one vector merge
+                bool riding = false;
+                for (int d = 0; d < lanes; ++d) {
+                    candidate[d] = UNREACHED;
+                    if (trip[d] == -1) continue;
+                    riding = true;
+                    int32_t arrival = pattern.arrival(trip[d], position) + shift[d];
+                    if (arrival <= lane_end[d]) candidate[d] = arrival;
+                }
+                if (riding && relaxLanes(trip_round.at(stop_id), candidate.data(), trip_best.at(stop_id), lanes)) {
+                    if (!trip_marked[stop_id]) {
+                        trip_marked[stop_id] = 1;
+                        trip_stops.push_back(stop_id);
+                    }
+                    // best is never later than trip_best, so the lanes dropped above would be dropped here too
+                    if (relaxLanes(round_arrival.at(stop_id), candidate.data(), best.at(stop_id), lanes)) mark(stop_id);
+                }
+
+                // Lanes reached here last round may catch an earlier trip
+                if (!previously_marked[stop_id]) continue;
+                const int32_t* ready = previous_arrival.at(stop_id);
+                for (int d = 0; d < lanes; ++d) {
+                    if (ready[d] == UNREACHED) continue;
+                    if (trip[d] != -1 && ready[d] >= pattern.departure(trip[d], position) + shift[d]) continue;
+                    int candidate_trip = -1, candidate_shift = 0;
+                    if (pattern.earliestTrip(position, ready[d], first_day, last_day, candidate_trip, candidate_shift) &&
+                        (trip[d] == -1 || pattern.departure(candidate_trip, position) + candidate_shift < pattern.departure(trip[d], position) + shift[d])) {
+                        trip[d] = candidate_trip;
+                        shift[d] = candidate_shift;
+                    }
+                }
+            }
+            queue_position[pattern_index] = -1;
+        }
+        queued_patterns.clear();
+        for (int stop_id : previous_stops) previously_marked[stop_id] = 0;
+
+        // Transfers start from what the route scans reached, not from other transfers
+        for (int stop_id : trip_stops) {
+            auto transfers = timetable.transfers_map.find(stop_id);
+            int32_t* source = trip_round.at(stop_id);
+            if (transfers != timetable.transfers_map.end()) {
+                for (const auto& transfer : transfers->second) {
+                    for (int d = 0; d < lanes; ++d) {
+                        candidate[d] = source[d] == UNREACHED ? UNREACHED : source[d] + transfer.duration_seconds;
+                    }
+                    if (relaxLanes(round_arrival.at(transfer.to_stop_id), candidate.data(), best.at(transfer.to_stop_id), lanes)) mark(transfer.to_stop_id);
+                }
+            }
+            minMergeArrivals(trip_best.at(stop_id), source, lanes);
+            std::fill(source, source + lanes, UNREACHED);
+            trip_marked[stop_id] = 0;
+        }
+        trip_stops.clear();
+
+        recordDestination(k);
+        if (stopped) break;
+        if (!minMergeArrivals(best.values.data(), round_arrival.values.data(), static_cast<int>(best.values.size()))) break;
+    }
+
+    for (const auto& options : lane_results) results.insert(results.end(), options.begin(), options.end());
+    return !stopped;
+}
@@ -2,147 +2,483 @@
 #include <vector>
 #include <string>
 #include <map>
-#include <set>
 #include <algorithm>
+#include <cstdint>
+#include <chrono>
 #include "Raptor.h"
 #include "DataTypes.h"
+#include "Timetable.h"
+#include "SimdKernels.h"
+#include "ParetoBag.h"
 
-const double WALKING_SPEED_MPS = 1.4;
-const double MAX_WALK_DISTANCE_METERS = 1500;
 
-void merge(std::vector<Journey>& profile, const Journey& new_journey) {
-    for (const auto& existing : profile) {
-        if (existing.arrival_time <= new_journey.arrival_time && existing.trips <= new_journey.trips) {
-            return;
-        }
+static Journey toJourney(const Label& label, const RoundLabels& labels, const Timetable& timetable) {
+    Journey journey;
+    journey.arrival_time = Time::fromSeconds(label.arrival);
+    journey.trips = label.trips;
+    journey.departure_time = Time::fromSeconds(label.departure);
+    journey.method = static_cast<JourneyMethod>(label.method);
+    if (label.parent != -1) journey.from_stop_id = labels[label.parentRound()][label.parent].stop_id;
+    if (label.method == METHOD_TRIP) journey.trip_id = timetable.patterns[label.pattern].trip_ids[label.trip];
+    journey.walk_meters = label.walk_meters;
+    journey.fare = label.fare;
+    journey.label_index = label.index;
+    return journey;
+}
+
+// A label riding a trip during a multi-criteria pattern scan
+struct RouteLabel {
+    Label boarded; // the label at the stop where the trip was boarded
+    int trip;
+    int shift;
+    int board_position;
+};
+
+// Adds `candidate` to the labels riding a pattern unless one of them boards an earlier or the
+// same trip and is no worse on the extra criteria; removes the ones it beats in turn.
+static void mergeRouteLabel(std::vector<RouteLabel>& route_bag, const RouteLabel& candidate, const RoutePattern& pattern,
+                            int position, const RaptorCriteria& criteria) {
+    auto beats = [&](const RouteLabel& a, const RouteLabel& b) {
+        return pattern.departure(a.trip, position) + a.shift <= pattern.departure(b.trip, position) + b.shift &&
+               (!criteria.walking || a.boarded.walk_meters <= b.boarded.walk_meters) &&
+               // Leg fares depend on the boarding zone, so only same-zone fares compare
+               (!criteria.fare || (a.boarded.fare <= b.boarded.fare && pattern.zone(a.board_position) == pattern.zone(b.board_position)));
+    };
+    for (const auto& existing : route_bag) {
+        if (beats(existing, candidate)) return;
     }
-    profile.erase(std::remove_if(profile.begin(), profile.end(),
-        [&](const Journey& existing) {
-            return new_journey.arrival_time <= existing.arrival_time && new_journey.trips <= existing.trips;
-        }),
-    profile.end());
-    profile.push_back(new_journey);
+    route_bag.erase(std::remove_if(route_bag.begin(), route_bag.end(),
+        [&](const RouteLabel& existing) { return beats(candidate, existing); }),
+    route_bag.end());
+    route_bag.push_back(candidate);
 }
 
+// Working arrays of one search, indexed by stop id or pattern. Each worker thread keeps one
+// across queries, so a search only clears what the previous one touched instead of allocating
+// and filling every array again.
+struct RaptorScratch {
+    std::vector<int32_t> best_arrival, round_arrival, previous_arrival, trip_arrival;
+    std::vector<ParetoBag> previous_bags, round_bags, reached_bags, all_bags, trip_bags;
+    std::vector<int> previous_stops, round_stops, reached_stops;
+    std::vector<Label> reached_labels;
+    std::vector<char> touched;          // per stop: written since the last prepare()
+    std::vector<int> touched_stops;
+    std::vector<int> queue_position;    // per pattern; -1 when not queued
+    std::vector<int> queued_patterns;
+    std::vector<int32_t> nearby;
+    std::vector<RouteLabel> route_bag;
+
+    // Every write to a stop's arrivals or bags goes with a label added to one of its bags, so
+    // marking stops there is enough to find them again
+    void touch(int stop_id) {
+        if (touched[stop_id]) return;
+        touched[stop_id] = 1;
+        touched_stops.push_back(stop_id);
+    }
+
+    // Resets what the previous search left, then fits the arrays to `timetable`, which changes
+    // on a reload
+    void prepare(const Timetable& timetable) {
+        for (int stop_id : touched_stops) {
+            best_arrival[stop_id] = round_arrival[stop_id] = previous_arrival[stop_id] = trip_arrival[stop_id] = UNREACHED;
+            previous_bags[stop_id].clear();
+            round_bags[stop_id].clear();
+            reached_bags[stop_id].clear();
+            all_bags[stop_id].clear();
+            trip_bags[stop_id].clear();
+            touched[stop_id] = 0;
+        }
+        touched_stops.clear();
+        for (int pattern_index : queued_patterns) queue_position[pattern_index] = -1;
+        queued_patterns.clear();
+        previous_stops.clear();
+        round_stops.clear();
+        reached_stops.clear();
+
+        const size_t stop_slots = timetable.stop_id_limit;
+        best_arrival.resize(stop_slots, UNREACHED);
+        round_arrival.resize(stop_slots, UNREACHED);
+        previous_arrival.resize(stop_slots, UNREACHED);
+        trip_arrival.resize(stop_slots, UNREACHED);
+        previous_bags.resize(stop_slots);
+        round_bags.resize(stop_slots);
+        reached_bags.resize(stop_slots);
+        all_bags.resize(stop_slots);
+        trip_bags.resize(stop_slots);
+        touched.resize(stop_slots, 0);
+        nearby.resize(stop_slots);
+        queue_position.resize(timetable.patterns.size(), -1);
+    }
+};
+
+static thread_local RaptorScratch worker_scratch;
+
 void runMultiCriteriaRaptor(int start_stop_id, int end_stop_id, const Time& start_time,
-                            const std::map<int, Stop>& stops,
-                            const std::map<int, std::vector<Transfer>>& transfers_map,
-                            const std::map<std::string, std::vector<StopTime>>& trips_map,
-                            const std::map<int, std::vector<std::string>>& routes_serving_stop,
+                            const Timetable& timetable,
                             std::map<int, std::vector<Journey>>& final_profiles,
-                            std::map<int, std::map<int, Journey>>& predecessors) {
+                            RoundLabels& labels,
+                            int horizon_seconds,
+                            const RaptorCriteria& criteria,
+                            RaptorStats* stats,
+                            const RaptorLimits& limits) {
 
-    const int MAX_TRIPS = 5;
-    std::vector<std::map<int, std::vector<Journey>>> profiles_by_round(MAX_TRIPS + 1);
+    // Phase times are only read from the clock when the search is explained
+    RaptorExplain* explain = stats ? stats->explain : nullptr;
+    RoundStats* round_stats = nullptr;
+    std::chrono::steady_clock::time_point phase_start;
+    if (explain) phase_start = std::chrono::steady_clock::now();
+    auto endPhase = [&](int64_t RaptorExplain::*phase_micros) {
+        if (!explain) return;
+        auto now = std::chrono::steady_clock::now();
+        explain->*phase_micros = std::chrono::duration_cast<std::chrono::microseconds>(now - phase_start).count();
+        phase_start = now;
+    };
+
+    const auto& stops = timetable.stops;
+    // With only (arrival, trips), a round keeps one label per stop and flat arrival arrays can prune.
+    // Extra criteria keep whole Pareto bags per stop, so pruning checks every label found so far.
+    const bool extra_criteria = criteria.any();
+    const auto& transfers_map = timetable.transfers_map;
+    // Labels are only kept while they fall inside [start_time, start_time + horizon]; the window
+    // may run past 24:00:00 into the next service day(s).
+    const int window_start = start_time.toSeconds();
+    const int window_end = window_start + horizon_seconds;
+
+    // Per-stop arrival seconds: the best over all finished rounds, the round being built and the
+    // previous round. Each round keeps at most one label per stop, so these mirror the bags and
+    // let dominated labels be rejected before they are ever merged. `trip_arrival` is the best
+    // arrival by trip over all rounds, the only thing a new trip arrival has to beat.
+    const int stop_slots = timetable.stop_id_limit;
+    RaptorScratch& scratch = worker_scratch;
+    scratch.prepare(timetable);
+    auto& best_arrival = scratch.best_arrival;
+    auto& round_arrival = scratch.round_arrival;
+    auto& previous_arrival = scratch.previous_arrival;
+    auto& trip_arrival = scratch.trip_arrival;
+
+    // Per-stop Pareto bags indexed by stop id: the previous round, the round being built, what
+    // this round's route scans reached (transfers only start from those), all rounds so far and,
+    // with extra criteria, the trip arrivals of all rounds so far.
+    // Each list holds the stops whose bag is not empty; a round clears only those, so the bags
+    // keep their capacity from round to round and from query to query.
+    auto& previous_bags = scratch.previous_bags;
+    auto& round_bags = scratch.round_bags;
+    auto& reached_bags = scratch.reached_bags;
+    auto& all_bags = scratch.all_bags;
+    auto& trip_bags = scratch.trip_bags;
+    auto& previous_stops = scratch.previous_stops;
+    auto& round_stops = scratch.round_stops;
+    auto& reached_stops = scratch.reached_stops;
+    auto addLabel = [&](std::vector<ParetoBag>& bags, std::vector<int>& listed, int stop_id, const Label& label) {
+        if (bags[stop_id].empty()) listed.push_back(stop_id);
+        scratch.touch(stop_id);
+        bags[stop_id].insert(label, criteria);
+    };
+
+    // True if a label at stop_id is not dominated by one from this or an earlier round; without
+    // extra criteria, the stop's arrival in this round becomes the label's
+    auto beatsKnown = [&](int stop_id, const Label& label) {
+        if (extra_criteria) return !all_bags[stop_id].dominated(label, criteria);
+        if (label.arrival >= std::min(best_arrival[stop_id], round_arrival[stop_id])) return false;
+        round_arrival[stop_id] = label.arrival;
+        return true;
+    };
+    // A stop reached on foot is not walked on from, so a trip arrival only has to beat the earlier
+    // trip arrivals there: one later than a walk still leads on by transfer
+    auto beatsTrips = [&](int stop_id, const Label& label) {
+        if (extra_criteria) return !trip_bags[stop_id].dominated(label, criteria);
+        if (label.arrival >= trip_arrival[stop_id]) return false;
+        trip_arrival[stop_id] = label.arrival;
+        return true;
+    };
+    auto counted = [&](bool better) {
+        if (round_stats) ++(better ? round_stats->labels_merged : round_stats->labels_dominated);
+        return better;
+    };
+
+    // Every label that reaches a round's bags is first appended to that round's array, where it stays
+    // even if it is dominated later, so parent references remain valid. The arrays keep their
+    // capacity when the caller reuses `labels`.
+    labels.resize(limits.max_trips + 1);
+    for (auto& round : labels) round.clear();
+    auto store = [&](Label label) {
+        label.index = static_cast<int32_t>(labels[label.trips].size());
+        labels[label.trips].push_back(label);
+        return label;
+    };
+    // A finished (or stopped) round joins the union of all rounds
+    auto addRoundToAll = [&]() {
+        for (int stop_id : round_stops) {
+            for (const auto& label : round_bags[stop_id]) all_bags[stop_id].insert(label, criteria);
+        }
+    };
 
     // Round 0: Initialize
-    merge(profiles_by_round[0][start_stop_id], {start_time, 0, start_time, -1, "Start"});
+    const Label origin = store({window_start, window_start, 0, 0, start_stop_id, -1, -1, -1, -1, -1, 0, 0, METHOD_START});
+    addLabel(round_bags, round_stops, start_stop_id, origin);
     const Stop& start_stop_details = stops.at(start_stop_id);
-    for (const auto& stop_pair : stops) {
-        double distance = haversine(start_stop_details.lat, start_stop_details.lon, stop_pair.second.lat, stop_pair.second.lon);
-        if (distance <= MAX_WALK_DISTANCE_METERS && stop_pair.first != start_stop_id) {
-            int walk_duration_seconds = static_cast<int>(distance / WALKING_SPEED_MPS);
-            Journey j = {Time::fromSeconds(start_time.toSeconds() + walk_duration_seconds), 0, start_time, start_stop_id, "Walk"};
-            merge(profiles_by_round[0][stop_pair.first], j);
+    // Candidates come from the vectorized approximate filter; haversine confirms each one
+    auto& nearby = scratch.nearby;
+    int nearby_count = start_stop_details.has_location
+        ? filterNearbyStops(start_stop_details.lat, start_stop_details.lon, timetable.stop_lats.data(), timetable.stop_lons.data(), stop_slots, limits.max_walk_meters, nearby.data())
+        : 0;
+    for (int i = 0; i < nearby_count; ++i) {
+        auto stop_it = stops.find(nearby[i]);
+        if (stop_it == stops.end() || stop_it->first == start_stop_id) continue;
+        double distance = haversine(start_stop_details.lat, start_stop_details.lon, stop_it->second.lat, stop_it->second.lon);
+        if (distance <= limits.max_walk_meters) {
+            int walk_duration_seconds = static_cast<int>(distance / limits.walking_speed_mps);
+            Label label = {window_start + walk_duration_seconds, window_start, static_cast<int32_t>(distance), 0, stop_it->first, -1, -1, -1, -1, origin.index, 0, 0, METHOD_WALK};
+            addLabel(round_bags, round_stops, stop_it->first, store(label));
         }
     }
-    if (transfers_map.count(start_stop_id)) {
-        for (const auto& transfer : transfers_map.at(start_stop_id)) {
-            Journey j = {Time::fromSeconds(start_time.toSeconds() + transfer.duration_seconds), 0, start_time, start_stop_id, "Walk"};
-            merge(profiles_by_round[0][transfer.to_stop_id], j);
+    auto start_transfers = transfers_map.find(start_stop_id);
+    if (start_transfers != transfers_map.end()) {
+        for (const auto& transfer : start_transfers->second) {
+            Label label = {window_start + transfer.duration_seconds, window_start, transfer.distance_meters, 0, transfer.to_stop_id, -1, -1, -1, -1, origin.index, 0, 0, METHOD_WALK};
+            addLabel(round_bags, round_stops, transfer.to_stop_id, store(label));
         }
     }
 
+    // The origin was walked on from above, as if a trip had arrived there
+    trip_arrival[start_stop_id] = window_start;
+    if (extra_criteria) trip_bags[start_stop_id].insert(origin, criteria);
+    for (int stop_id : round_stops) round_arrival[stop_id] = round_bags[stop_id].front().arrival;
+    addRoundToAll();
+    for (int stop_id : round_stops) best_arrival[stop_id] = round_arrival[stop_id];
+    endPhase(&RaptorExplain::seeding_micros);
+
     // RAPTOR Rounds
-    for (int k = 1; k <= MAX_TRIPS; ++k) {
-        std::map<int, std::vector<Journey>> reached_this_round;
-        for (const auto& pair : profiles_by_round[k - 1]) {
-            int stop_id = pair.first;
-            if (routes_serving_stop.count(stop_id)) {
-                for (const auto& trip_id : routes_serving_stop.at(stop_id)) {
-                    const auto& schedule = trips_map.at(trip_id);
-                    int boarding_stop_seq = -1;
-                    for (size_t i = 0; i < schedule.size(); ++i) {
-                        if (schedule[i].stop_id == stop_id) {
-                            boarding_stop_seq = i;
-                            break;
-                        }
+    // A stopped search keeps what the current round reached so far: every label is a real journey
+    auto& queue_position = scratch.queue_position;
+    auto& queued_patterns = scratch.queued_patterns;
+    const bool bounded = limits.bounded();
+    bool stopped = false;
+    int scans_until_check = CANCELLATION_CHECK_INTERVAL;
+    for (int k = 1; k <= limits.max_trips; ++k) {
+        if (bounded && limits.expired()) {
+            stopped = true;
+            break;
+        }
+        // Round k - 2 is overwritten; it only ever set arrivals at stops it has bags for
+        previous_bags.swap(round_bags);
+        previous_stops.swap(round_stops);
+        previous_arrival.swap(round_arrival);
+        for (int stop_id : round_stops) {
+            round_bags[stop_id].clear();
+            round_arrival[stop_id] = UNREACHED;
+        }
+        round_stops.clear();
+
+        // Every pattern serving a stop reached last round is scanned once, from the earliest such stop
+        for (int stop_id : previous_stops) {
+            auto serving = timetable.patterns_serving_stop.find(stop_id);
+            if (serving == timetable.patterns_serving_stop.end()) continue;
+            for (const auto& pattern_stop : serving->second) {
+                int& position = queue_position[pattern_stop.pattern];
+                if (position == -1) queued_patterns.push_back(pattern_stop.pattern);
+                if (position == -1 || pattern_stop.position < position) position = pattern_stop.position;
+            }
+        }
+        // Patterns in index order, so that ties between equally good labels go the same way every time
+        std::sort(queued_patterns.begin(), queued_patterns.end());
+
+        if (stats && !queued_patterns.empty()) {
+            ++stats->rounds;
+            stats->patterns_scanned += static_cast<int>(queued_patterns.size());
+        }
+        if (explain) {
+            explain->rounds.emplace_back();
+            round_stats = &explain->rounds.back();
+            round_stats->marked_stops = static_cast<int>(previous_stops.size());
+            round_stats->patterns_scanned = static_cast<int>(queued_patterns.size());
+        }
+
+        for (int pattern_index : queued_patterns) {
+            if (bounded && --scans_until_check == 0) {
+                scans_until_check = CANCELLATION_CHECK_INTERVAL;
+                if (limits.expired()) {
+                    stopped = true;
+                    break;
+                }
+            }
+            const RoutePattern& pattern = timetable.patterns[pattern_index];
+            const int first_position = queue_position[pattern_index];
+            // Only service days whose run of this pattern overlaps the query window are considered
+            int first_day, last_day;
+            pattern.serviceDays(window_start, window_end, first_day, last_day);
+            if (round_stats) round_stats->stop_events += pattern.stopCount() - first_position;
+
+            if (extra_criteria) {
+                // McRAPTOR scan: every non-dominated label from the previous round rides its own trip
+                auto& route_bag = scratch.route_bag;
+                route_bag.clear();
+                for (int position = first_position; position < pattern.stopCount(); ++position) {
+                    int stop_id = pattern.stops[position];
+                    for (const auto& label : route_bag) {
+                        int arrival = pattern.arrival(label.trip, position) + label.shift;
+                        if (arrival > window_end) continue;
+                        // Fares are only priced when they are a criterion; results get theirs from their legs
+                        int fare = criteria.fare ? label.boarded.fare + timetable.legFare(pattern, label.board_position, position) : 0;
+                        Label new_label = {arrival, label.boarded.departure, label.boarded.walk_meters, fare,
+                                           stop_id, pattern_index, label.trip, label.board_position, position, label.boarded.index, 0, static_cast<int16_t>(k), METHOD_TRIP};
+                        if (counted(beatsTrips(stop_id, new_label))) addLabel(reached_bags, reached_stops, stop_id, new_label);
                     }
 
-                    if (boarding_stop_seq != -1) {
-                        Journey current_trip_journey;
-                        current_trip_journey.from_stop_id = -1;
-                        for (size_t i = boarding_stop_seq; i < schedule.size(); ++i) {
-                            const auto& stop_time = schedule[i];
-                            if (profiles_by_round[k - 1].count(stop_time.stop_id)) {
-                                for (const auto& prev_journey : profiles_by_round[k-1].at(stop_time.stop_id)) {
-                                    if (prev_journey.arrival_time <= stop_time.departure_time) {
-                                        if (current_trip_journey.from_stop_id == -1 || prev_journey.arrival_time < current_trip_journey.arrival_time) {
-                                            current_trip_journey = prev_journey;
-                                        }
-                                    }
-                                }
-                            }
-                            if (current_trip_journey.from_stop_id != -1) {
-                                int predecessor_id = (i > static_cast<size_t>(boarding_stop_seq)) ? schedule[i-1].stop_id : current_trip_journey.from_stop_id;
-                                Journey new_journey = {stop_time.arrival_time, k, current_trip_journey.departure_time, predecessor_id, "Trip " + trip_id};
-                                merge(reached_this_round[stop_time.stop_id], new_journey);
-                            }
+                    for (const auto& prev_label : previous_bags[stop_id]) {
+                        RouteLabel candidate = {prev_label, -1, 0, position};
+                        if (pattern.earliestTrip(position, prev_label.arrival, first_day, last_day, candidate.trip, candidate.shift)) {
+                            mergeRouteLabel(route_bag, candidate, pattern, position, criteria);
                         }
                     }
                 }
+                continue;
             }
-        }
 
-        for (const auto& pair : reached_this_round) {
-            for (const auto& journey : pair.second) {
-                merge(profiles_by_round[k][pair.first], journey);
-                if (transfers_map.count(pair.first)) {
-                    for (const auto& transfer : transfers_map.at(pair.first)) {
-                        Journey transfer_journey = { Time::fromSeconds(journey.arrival_time.toSeconds() + transfer.duration_seconds), journey.trips, journey.departure_time, pair.first, "Walk" };
-                        merge(profiles_by_round[k][transfer.to_stop_id], transfer_journey);
+            int trip = -1;
+            int shift = 0;
+            int board_position = -1;
+            Label boarded_label = {};
+            for (int position = first_position; position < pattern.stopCount(); ++position) {
+                int stop_id = pattern.stops[position];
+                if (trip != -1) {
+                    int arrival = pattern.arrival(trip, position) + shift;
+                    // Without extra criteria there is no fare criterion, so no fare is priced here
+                    Label new_label = {arrival, boarded_label.departure, boarded_label.walk_meters, 0,
+                                       stop_id, pattern_index, trip, board_position, position, boarded_label.index, 0, static_cast<int16_t>(k), METHOD_TRIP};
+                    if (arrival <= window_end && counted(beatsTrips(stop_id, new_label))) {
+                        addLabel(reached_bags, reached_stops, stop_id, new_label);
+                    }
+                }
+
+                // Board here if the previous round reached this stop in time for an earlier trip
+                int ready_time = previous_arrival[stop_id];
+                if (ready_time == UNREACHED) continue;
+                if (trip != -1 && ready_time >= pattern.departure(trip, position) + shift) continue;
+                int candidate_trip = -1, candidate_shift = 0;
+                if (pattern.earliestTrip(position, ready_time, first_day, last_day, candidate_trip, candidate_shift) &&
+                    (trip == -1 || pattern.departure(candidate_trip, position) + candidate_shift < pattern.departure(trip, position) + shift)) {
+                    trip = candidate_trip;
+                    shift = candidate_shift;
+                    board_position = position;
+                    for (const auto& prev_label : previous_bags[stop_id]) {
+                        if (prev_label.arrival == ready_time) boarded_label = prev_label;
                     }
                 }
             }
         }
-    }
+        for (int pattern_index : queued_patterns) queue_position[pattern_index] = -1;
+        queued_patterns.clear();
 
-    // --- NEW, EFFICIENT FINALIZATION LOGIC ---
-    std::map<int, std::vector<Journey>> temp_final_profiles;
-    for (int k = 0; k <= MAX_TRIPS; ++k) {
-        for (const auto& profile_pair : profiles_by_round[k]) {
-            int stop_id = profile_pair.first;
-            for (const auto& journey : profile_pair.second) {
-                merge(temp_final_profiles[stop_id], journey);
+        // Stops in id order, for the same reason as the patterns. Only trip arrivals that beat
+        // every earlier label at their stop are boarded from next round; all of them are walked on
+        // from, after the round's own trip arrivals have been settled.
+        std::sort(reached_stops.begin(), reached_stops.end());
+        auto& reached_labels = scratch.reached_labels;
+        reached_labels.clear();
+        for (int stop_id : reached_stops) {
+            for (const auto& reached : reached_bags[stop_id]) {
+                const Label label = store(reached);
+                reached_labels.push_back(label);
+                if (extra_criteria) trip_bags[stop_id].insert(label, criteria);
+                if (beatsKnown(stop_id, label)) addLabel(round_bags, round_stops, stop_id, label);
+            }
+            reached_bags[stop_id].clear();
+        }
+        reached_stops.clear();
+        for (const Label& label : reached_labels) {
+            auto transfers = transfers_map.find(label.stop_id);
+            if (transfers == transfers_map.end()) continue;
+            for (const auto& transfer : transfers->second) {
+                Label transfer_label = { label.arrival + transfer.duration_seconds, label.departure, label.walk_meters + transfer.distance_meters, label.fare,
+                                         transfer.to_stop_id, -1, -1, -1, -1, label.index, 0, label.trips, METHOD_WALK };
+                if (!counted(beatsKnown(transfer.to_stop_id, transfer_label))) continue;
+                addLabel(round_bags, round_stops, transfer.to_stop_id, store(transfer_label));
             }
         }
+
+        addRoundToAll();
+        if (stopped) break;
+        // Nothing improved means no later round can improve either
+        if (extra_criteria) {
+            if (round_stops.empty()) break;
+        } else if (!minMergeArrivals(best_arrival.data(), round_arrival.data(), stop_slots)) {
+            break;
+        }
     }
 
+    if (stats) stats->partial = stopped;
+    round_stats = nullptr;
+    endPhase(&RaptorExplain::rounds_micros);
+
+    // The destination's options: walks from every stop near it, then the labels at the stop itself
+    ParetoBag final_bag;
     const Stop& end_stop_details = stops.at(end_stop_id);
-    for (const auto& profile_pair : temp_final_profiles) {
-        int reached_stop_id = profile_pair.first;
+    nearby_count = end_stop_details.has_location
+        ? filterNearbyStops(end_stop_details.lat, end_stop_details.lon, timetable.stop_lats.data(), timetable.stop_lons.data(), stop_slots, limits.max_walk_meters, nearby.data())
+        : 0;
+    for (int i = 0; i < nearby_count; ++i) {
+        int reached_stop_id = nearby[i];
         if (reached_stop_id == end_stop_id) continue; // No need to walk from destination to itself
+        if (all_bags[reached_stop_id].empty()) continue;
 
         const Stop& reached_stop_details = stops.at(reached_stop_id);
         double distance = haversine(reached_stop_details.lat, reached_stop_details.lon, end_stop_details.lat, end_stop_details.lon);
-        if (distance <= MAX_WALK_DISTANCE_METERS) {
-            int walk_duration_seconds = static_cast<int>(distance / WALKING_SPEED_MPS);
-            for (const auto& journey : profile_pair.second) {
-                 Journey final_walk = { Time::fromSeconds(journey.arrival_time.toSeconds() + walk_duration_seconds), journey.trips, journey.departure_time, reached_stop_id, "Walk" };
-                merge(final_profiles[end_stop_id], final_walk);
+        if (distance <= limits.max_walk_meters) {
+            int walk_duration_seconds = static_cast<int>(distance / limits.walking_speed_mps);
+            for (const auto& label : all_bags[reached_stop_id]) {
+                Label final_walk = { label.arrival + walk_duration_seconds, label.departure, label.walk_meters + static_cast<int32_t>(distance), label.fare,
+                                     end_stop_id, -1, -1, -1, -1, label.index, 0, label.trips, METHOD_WALK };
+                final_bag.insert(store(final_walk), criteria);
             }
         }
     }
+    for (const auto& label : all_bags[end_stop_id]) final_bag.insert(label, criteria);
 
-    for (const auto& pair : temp_final_profiles) {
-        for (const auto& journey : pair.second) {
-            merge(final_profiles[pair.first], journey);
-        }
+    if (stats) {
+        for (const auto& round : labels) stats->labels_created += static_cast<int>(round.size());
+    }
+
+    if (!final_bag.empty()) {
+        std::vector<Journey>& profile = final_profiles[end_stop_id];
+        for (const auto& label : final_bag) profile.push_back(toJourney(label, labels, timetable));
     }
+    endPhase(&RaptorExplain::finalization_micros);
+}
 
-    for(const auto& profile_pair : final_profiles) {
-        for(const auto& journey : profile_pair.second) {
-            predecessors[profile_pair.first][journey.trips] = journey;
+std::vector<JourneyLeg> reconstructLegs(const Journey& journey, const RoundLabels& labels, const Timetable& timetable, bool with_stops) {
+    std::vector<JourneyLeg> legs;
+    const Label* label = &labels[journey.trips][journey.label_index];
+    while (label->parent != -1) {
+        const Label& parent = labels[label->parentRound()][label->parent];
+        JourneyLeg leg;
+        leg.method = static_cast<JourneyMethod>(label->method);
+        leg.from_stop_id = parent.stop_id;
+        leg.to_stop_id = label->stop_id;
+        leg.arrival_time = Time::fromSeconds(label->arrival);
+        if (label->method == METHOD_TRIP) {
+            // The label knows where on its pattern it boarded and alighted, which also holds on
+            // patterns that pass a stop twice; the day shift follows from the arrival there
+            const RoutePattern& pattern = timetable.patterns[label->pattern];
+            const int board = label->board, alight = label->alight;
+            const int shift = label->arrival - pattern.arrival(label->trip, alight);
+            leg.departure_time = Time::fromSeconds(pattern.departure(label->trip, board) + shift);
+            leg.trip_id = pattern.trip_ids[label->trip];
+            leg.route_id = pattern.route_id;
+            leg.fare = timetable.legFare(pattern, board, alight);
+            if (with_stops) {
+                for (int position = board + 1; position < alight; ++position) {
+                    leg.stops.push_back({pattern.stops[position], Time::fromSeconds(pattern.arrival(label->trip, position) + shift),
+                                         Time::fromSeconds(pattern.departure(label->trip, position) + shift)});
+                }
+            }
+        } else {
+            leg.departure_time = Time::fromSeconds(parent.arrival);
+            leg.walk_meters = label->walk_meters - parent.walk_meters;
         }
+        legs.push_back(leg);
+        label = &parent;
     }
+    std::reverse(legs.begin(), legs.end());
+    return legs;
 }
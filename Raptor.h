@@ -4,24 +4,134 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <cstdint>
+#include <chrono>
+#include <functional>
 #include "DataTypes.h"
+#include "Timetable.h"
+#include "ParetoBag.h"
 
-// Struct to hold a single step of a reconstructed path
-struct PathStep {
+// A stop a trip leg passes between boarding and alighting
+struct LegStop {
     int stop_id;
-    std::string stop_name;
     Time arrival_time;
-    std::string method;
+    Time departure_time;
 };
 
-// Main algorithm function declaration
+// One leg of a reconstructed journey: a ride on a single trip, or a walk
+struct JourneyLeg {
+    JourneyMethod method;
+    int from_stop_id;
+    Time departure_time;
+    int to_stop_id;
+    Time arrival_time;
+    StringId trip_id = NO_STRING;  // trip legs
+    StringId route_id = NO_STRING; // trip legs, if the feed has trips.txt
+    int walk_meters = 0;           // walk legs
+    int fare = 0;                  // trip legs
+    std::vector<LegStop> stops;    // intermediate stops, only filled when asked for
+};
+
+const int DEFAULT_HORIZON_SECONDS = SECONDS_PER_DAY;
+
+// Defaults of RaptorLimits
+const int MAX_TRIPS = 5;
+const double WALKING_SPEED_MPS = 1.4;
+const double MAX_WALK_DISTANCE_METERS = 1500;
+
+// Route scans between two checks of the deadline and the cancellation callback
+const int CANCELLATION_CHECK_INTERVAL = 16;
+
+// How far one search may go; the server sets these from its configuration and the request
+struct RaptorLimits {
+    int max_trips = MAX_TRIPS;                            // rounds
+    double max_walk_meters = MAX_WALK_DISTANCE_METERS;    // walks to and from the end stops
+    double walking_speed_mps = WALKING_SPEED_MPS;
+    // Checked before every round and every CANCELLATION_CHECK_INTERVAL route scans. Once the
+    // deadline has passed or `cancelled` returns true, the search stops scanning and answers
+    // with the journeys found so far.
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    std::function<bool()> cancelled; // e.g. the client has gone away; may be empty
+
+    bool bounded() const { return cancelled || deadline != std::chrono::steady_clock::time_point::max(); }
+    bool expired() const {
+        return (deadline != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= deadline) ||
+               (cancelled && cancelled());
+    }
+};
+
+// Arrival time (seconds) of a stop not reached yet
+const int32_t UNREACHED = INT32_MAX;
+
+// A profile query evaluates this many departure times at most in one pass
+const int MAX_PROFILE_DEPARTURES = 64;
+
+// One Pareto-optimal (arrival, trips) option for one departure time of a profile query
+struct ProfileJourney {
+    Time departure_time;
+    Time arrival_time;
+    int trips;
+};
+
+// Work done in one round of an explained search
+struct RoundStats {
+    int marked_stops = 0;     // stops reached by the previous round
+    int patterns_scanned = 0;
+    int stop_events = 0;      // pattern positions visited by the scans
+    int labels_merged = 0;    // candidate labels that were not dominated when found
+    int labels_dominated = 0; // candidate labels rejected by earlier ones
+};
+
+// Detailed trace of one search, for finding slow origin/destination pairs
+struct RaptorExplain {
+    std::vector<RoundStats> rounds;
+    int64_t seeding_micros = 0;        // round 0: the origin and walks from it
+    int64_t rounds_micros = 0;
+    int64_t finalization_micros = 0;   // merging rounds and walks to the destination
+    int64_t reconstruction_micros = 0; // filled by the caller, which rebuilds the legs
+};
+
+// Work done by one search
+struct RaptorStats {
+    int rounds = 0;           // rounds that scanned at least one pattern
+    int patterns_scanned = 0;
+    int labels_created = 0;   // labels kept in RoundLabels
+    bool partial = false;     // the deadline or cancellation cut the search short; results may miss journeys
+    // Set to collect per-round counters and phase times as well; left null, the search only
+    // tests the pointer once per candidate label
+    RaptorExplain* explain = nullptr;
+};
+
+// Every label a search kept, indexed by round (= number of trips); Label::parent links them up
+typedef std::vector<std::vector<Label>> RoundLabels;
+
+// Searches journeys from start_stop_id to end_stop_id and adds the Pareto-optimal ones to
+// final_profiles[end_stop_id]; no other stop gets an entry. `labels` receives every label kept,
+// for reconstructLegs.
 void runMultiCriteriaRaptor(int start_stop_id, int end_stop_id, const Time& start_time,
-                            const std::map<int, Stop>& stops,
-                            const std::map<int, std::vector<Transfer>>& transfers_map,
-                            const std::map<std::string, std::vector<StopTime>>& trips_map,
-                            const std::map<int, std::vector<std::string>>& routes_serving_stop,
+                            const Timetable& timetable,
                             std::map<int, std::vector<Journey>>& final_profiles,
-                            std::map<int, std::map<int, Journey>>& predecessors
+                            RoundLabels& labels,
+                            int horizon_seconds = DEFAULT_HORIZON_SECONDS,
+                            const RaptorCriteria& criteria = RaptorCriteria(),
+                            RaptorStats* stats = nullptr,
+                            const RaptorLimits& limits = RaptorLimits()
                            );
 
+// The legs from the origin to `journey`, a result of the search that filled `labels`, found by
+// following parent references back from its label. Intermediate stops are added if `with_stops`.
+std::vector<JourneyLeg> reconstructLegs(const Journey& journey, const RoundLabels& labels, const Timetable& timetable,
+                                        bool with_stops = false);
+
+// Runs the same search for up to MAX_PROFILE_DEPARTURES departure times from one origin at once.
+// Every stop carries one arrival per departure time, so each route scan serves all of them and
+// labels are merged with vector min operations. Returns the destination's Pareto options for
+// every departure time, in departure order; no paths are reconstructed. Returns false if the
+// deadline or cancellation in `limits` cut the search short.
+bool runProfileRaptor(int start_stop_id, int end_stop_id, const std::vector<Time>& departure_times,
+                      const Timetable& timetable,
+                      std::vector<ProfileJourney>& results,
+                      int horizon_seconds = DEFAULT_HORIZON_SECONDS,
+                      const RaptorLimits& limits = RaptorLimits());
+
 #endif // RAPTOR_H_INCLUDED
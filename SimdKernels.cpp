@@ -0,0 +1,219 @@
+#define _USE_MATH_DEFINES // For M_PI constant
+#include <algorithm>
+#include <cmath>
+#include "SimdKernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TP_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+// Binary search narrows the range to this many elements before a linear (vector) scan finishes it
+static const int LINEAR_SCAN_WIDTH = 32;
+
+static int firstAtLeastScalar(const int32_t* values, int count, int32_t key) {
+    return static_cast<int>(std::lower_bound(values, values + count, key) - values);
+}
+
+static bool minMergeScalar(int32_t* best, const int32_t* candidate, int count) {
+    bool improved = false;
+    for (int i = 0; i < count; ++i) {
+        if (candidate[i] < best[i]) {
+            best[i] = candidate[i];
+            improved = true;
+        }
+    }
+    return improved;
+}
+
+// Scale factors and squared radius shared by every filterNearbyStops version
+struct NearbyFilter {
+    float lat0, lon0, meters_per_lat, meters_per_lon, radius_squared;
+    NearbyFilter(double lat, double lon, double radius_meters) {
+        const double EARTH_RADIUS = 6371000.0;
+        const double padded = radius_meters * 1.005 + 2.0; // projection error + float rounding
+        lat0 = static_cast<float>(lat);
+        lon0 = static_cast<float>(lon);
+        meters_per_lat = static_cast<float>(EARTH_RADIUS * M_PI / 180.0);
+        meters_per_lon = static_cast<float>(EARTH_RADIUS * M_PI / 180.0 * cos(lat * M_PI / 180.0));
+        radius_squared = static_cast<float>(padded * padded);
+    }
+    bool accepts(float lat, float lon) const {
+        float dy = (lat - lat0) * meters_per_lat;
+        float dx = (lon - lon0) * meters_per_lon;
+        return dx * dx + dy * dy <= radius_squared; // false for NaN
+    }
+};
+
+static int filterNearbyScalar(const NearbyFilter& filter, const float* lats, const float* lons, int begin, int count, int32_t* out) {
+    int found = 0;
+    for (int i = begin; i < count; ++i) {
+        if (filter.accepts(lats[i], lons[i])) out[found++] = i;
+    }
+    return found;
+}
+
+#ifdef TP_X86_KERNELS
+
+// Shrinks [0, count) to a window of at most LINEAR_SCAN_WIDTH elements that contains the answer
+static inline int narrowRange(const int32_t* values, int& count, int32_t key) {
+    int base = 0;
+    while (count > LINEAR_SCAN_WIDTH) {
+        int half = count / 2;
+        if (values[base + half - 1] < key) {
+            base += half;
+            count -= half;
+        } else {
+            count = half;
+        }
+    }
+    return base;
+}
+
+__attribute__((target("sse2")))
+static int firstAtLeastSse2(const int32_t* values, int count, int32_t key) {
+    int base = narrowRange(values, count, key);
+    const __m128i keys = _mm_set1_epi32(key);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + base + i));
+        int below = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(chunk, keys)));
+        if (below != 0xF) return base + i + __builtin_ctz(~below & 0xF);
+    }
+    for (; i < count; ++i) {
+        if (values[base + i] >= key) return base + i;
+    }
+    return base + count;
+}
+
+__attribute__((target("sse2")))
+static bool minMergeSse2(int32_t* best, const int32_t* candidate, int count) {
+    __m128i any = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(best + i));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(candidate + i));
+        __m128i lower = _mm_cmplt_epi32(c, b);
+        any = _mm_or_si128(any, lower);
+        // SSE2 has no 32-bit min; blend through the comparison mask
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(best + i),
+                         _mm_or_si128(_mm_and_si128(lower, c), _mm_andnot_si128(lower, b)));
+    }
+    bool improved = _mm_movemask_epi8(any) != 0;
+    return minMergeScalar(best + i, candidate + i, count - i) || improved;
+}
+
+__attribute__((target("sse2")))
+static int filterNearbySse2(const NearbyFilter& filter, const float* lats, const float* lons, int count, int32_t* out) {
+    const __m128 lat0 = _mm_set1_ps(filter.lat0), lon0 = _mm_set1_ps(filter.lon0);
+    const __m128 k_lat = _mm_set1_ps(filter.meters_per_lat), k_lon = _mm_set1_ps(filter.meters_per_lon);
+    const __m128 radius_squared = _mm_set1_ps(filter.radius_squared);
+    int found = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 dy = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(lats + i), lat0), k_lat);
+        __m128 dx = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(lons + i), lon0), k_lon);
+        __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        int mask = _mm_movemask_ps(_mm_cmple_ps(d2, radius_squared));
+        while (mask) {
+            out[found++] = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+    return found + filterNearbyScalar(filter, lats, lons, i, count, out + found);
+}
+
+__attribute__((target("avx2")))
+static int firstAtLeastAvx2(const int32_t* values, int count, int32_t key) {
+    int base = narrowRange(values, count, key);
+    const __m256i keys = _mm256_set1_epi32(key);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + base + i));
+        int below = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(keys, chunk)));
+        if (below != 0xFF) return base + i + __builtin_ctz(~below & 0xFF);
+    }
+    for (; i < count; ++i) {
+        if (values[base + i] >= key) return base + i;
+    }
+    return base + count;
+}
+
+__attribute__((target("avx2")))
+static bool minMergeAvx2(int32_t* best, const int32_t* candidate, int count) {
+    __m256i any = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(best + i));
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(candidate + i));
+        any = _mm256_or_si256(any, _mm256_cmpgt_epi32(b, c));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(best + i), _mm256_min_epi32(b, c));
+    }
+    bool improved = !_mm256_testz_si256(any, any);
+    return minMergeScalar(best + i, candidate + i, count - i) || improved;
+}
+
+__attribute__((target("avx2,fma")))
+static int filterNearbyAvx2(const NearbyFilter& filter, const float* lats, const float* lons, int count, int32_t* out) {
+    const __m256 lat0 = _mm256_set1_ps(filter.lat0), lon0 = _mm256_set1_ps(filter.lon0);
+    const __m256 k_lat = _mm256_set1_ps(filter.meters_per_lat), k_lon = _mm256_set1_ps(filter.meters_per_lon);
+    const __m256 radius_squared = _mm256_set1_ps(filter.radius_squared);
+    int found = 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 dy = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(lats + i), lat0), k_lat);
+        __m256 dx = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(lons + i), lon0), k_lon);
+        __m256 d2 = _mm256_fmadd_ps(dx, dx, _mm256_mul_ps(dy, dy));
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(d2, radius_squared, _CMP_LE_OQ));
+        while (mask) {
+            out[found++] = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+    return found + filterNearbyScalar(filter, lats, lons, i, count, out + found);
+}
+
+#endif // TP_X86_KERNELS
+
+// --- Runtime dispatch ---
+struct KernelSet {
+    int (*first_at_least)(const int32_t*, int, int32_t);
+    bool (*min_merge)(int32_t*, const int32_t*, int);
+    int (*filter_nearby)(const NearbyFilter&, const float*, const float*, int, int32_t*);
+    const char* name;
+};
+
+static int filterNearbyPlain(const NearbyFilter& filter, const float* lats, const float* lons, int count, int32_t* out) {
+    return filterNearbyScalar(filter, lats, lons, 0, count, out);
+}
+
+static KernelSet selectKernels() {
+#ifdef TP_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return {firstAtLeastAvx2, minMergeAvx2, filterNearbyAvx2, "avx2"};
+    if (__builtin_cpu_supports("sse2")) return {firstAtLeastSse2, minMergeSse2, filterNearbySse2, "sse2"};
+#endif
+    return {firstAtLeastScalar, minMergeScalar, filterNearbyPlain, "scalar"};
+}
+
+static const KernelSet& kernels() {
+    static const KernelSet selected = selectKernels();
+    return selected;
+}
+
+int firstAtLeast(const int32_t* values, int count, int32_t key) {
+    return kernels().first_at_least(values, count, key);
+}
+
+bool minMergeArrivals(int32_t* best, const int32_t* candidate, int count) {
+    return kernels().min_merge(best, candidate, count);
+}
+
+int filterNearbyStops(double lat0, double lon0, const float* lats, const float* lons, int count,
+                      double radius_meters, int32_t* out) {
+    return kernels().filter_nearby(NearbyFilter(lat0, lon0, radius_meters), lats, lons, count, out);
+}
+
+const char* simdLevelName() {
+    return kernels().name;
+}
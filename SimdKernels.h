@@ -0,0 +1,31 @@
+#ifndef SIMDKERNELS_H_INCLUDED
+#define SIMDKERNELS_H_INCLUDED
+
+#include <cstdint>
+
+// Vectorized inner loops of the RAPTOR engine. Each kernel has a scalar version and, on x86,
+// SSE2/AVX2 versions chosen once at runtime from what the CPU supports.
+
+// Index of the first element >= key in the non-decreasing array values[0, count), or count
+int firstAtLeast(const int32_t* values, int count, int32_t key);
+
+// best[i] = min(best[i], candidate[i]) for every i; returns true if any element decreased
+bool minMergeArrivals(int32_t* best, const int32_t* candidate, int count);
+
+// Largest radius filterNearbyStops is exact for; the server refuses walk limits beyond it
+const double NEARBY_FILTER_MAX_METERS = 10000;
+
+// Approximate distance filter over per-stop coordinate arrays (degrees, NaN where unknown).
+// Uses an equirectangular projection around (lat0, lon0), which stays within 0.1% of haversine
+// for distances up to NEARBY_FILTER_MAX_METERS at latitudes below 70 degrees; float coordinates
+// add about 1 m. The filter radius is padded past both, so it never drops a stop haversine would
+// accept within that range.
+// Writes the indices of candidate stops, in increasing order, to out and returns their count.
+// Callers confirm candidates with the exact haversine().
+int filterNearbyStops(double lat0, double lon0, const float* lats, const float* lons, int count,
+                      double radius_meters, int32_t* out);
+
+// Name of the kernel set in use ("avx2", "sse2" or "scalar"), for startup logging
+const char* simdLevelName();
+
+#endif // SIMDKERNELS_H_INCLUDED
@@ -0,0 +1,59 @@
+#include <cstring>
+#include "StringPool.h"
+
+StringPool::StringPool() : offsets_(1, 0), slots_(1024, NO_STRING) {}
+
+uint32_t StringPool::hash(const char* begin, const char* end) {
+    uint32_t h = 2166136261u; // FNV-1a
+    for (const char* p = begin; p < end; ++p) {
+        h ^= static_cast<unsigned char>(*p);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+StringId StringPool::lookup(const char* begin, const char* end, uint32_t h, size_t& slot) const {
+    size_t length = static_cast<size_t>(end - begin);
+    size_t mask = slots_.size() - 1;
+    for (slot = h & mask; slots_[slot] != NO_STRING; slot = (slot + 1) & mask) {
+        StringId id = slots_[slot];
+        if (this->length(id) == length && memcmp(c_str(id), begin, length) == 0) return id;
+    }
+    return NO_STRING;
+}
+
+StringId StringPool::intern(const char* begin, const char* end) {
+    size_t slot;
+    uint32_t h = hash(begin, end);
+    StringId id = lookup(begin, end, h, slot);
+    if (id != NO_STRING) return id;
+
+    id = static_cast<StringId>(size());
+    bytes_.insert(bytes_.end(), begin, end);
+    bytes_.push_back('\0');
+    offsets_.push_back(static_cast<uint32_t>(bytes_.size()));
+    slots_[slot] = id;
+    if (size() * 2 > slots_.size()) grow(); // keep the load factor under 1/2
+    return id;
+}
+
+StringId StringPool::find(const std::string& s) const {
+    size_t slot;
+    return lookup(s.data(), s.data() + s.size(), hash(s.data(), s.data() + s.size()), slot);
+}
+
+void StringPool::grow() {
+    std::vector<StringId> old_slots(slots_.size() * 2, NO_STRING);
+    old_slots.swap(slots_);
+    size_t mask = slots_.size() - 1;
+    for (StringId id : old_slots) {
+        if (id == NO_STRING) continue;
+        size_t slot = hash(c_str(id), c_str(id) + length(id)) & mask;
+        while (slots_[slot] != NO_STRING) slot = (slot + 1) & mask;
+        slots_[slot] = id;
+    }
+}
+
+size_t StringPool::bytesUsed() const {
+    return bytes_.capacity() + offsets_.capacity() * sizeof(uint32_t) + slots_.capacity() * sizeof(StringId);
+}
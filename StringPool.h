@@ -0,0 +1,41 @@
+#ifndef STRINGPOOL_H_INCLUDED
+#define STRINGPOOL_H_INCLUDED
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// 32-bit handle to a string interned in a StringPool
+typedef uint32_t StringId;
+const StringId NO_STRING = 0xFFFFFFFFu;
+
+// Append-only arena of unique strings (trip ids, stop names, ...). Each distinct string is
+// stored once, NUL-terminated, in one contiguous buffer and referred to by its StringId.
+// Interning is not thread-safe; lookups are safe once loading has finished.
+class StringPool {
+public:
+    StringPool();
+
+    StringId intern(const char* begin, const char* end);
+    StringId intern(const std::string& s) { return intern(s.data(), s.data() + s.size()); }
+    // Returns NO_STRING if the string was never interned
+    StringId find(const std::string& s) const;
+
+    const char* c_str(StringId id) const { return bytes_.data() + offsets_[id]; }
+    size_t length(StringId id) const { return offsets_[id + 1] - offsets_[id] - 1; }
+    std::string str(StringId id) const { return id == NO_STRING ? std::string() : std::string(c_str(id), length(id)); }
+    size_t size() const { return offsets_.size() - 1; }
+    size_t bytesUsed() const;
+
+private:
+    static uint32_t hash(const char* begin, const char* end);
+    StringId lookup(const char* begin, const char* end, uint32_t h, size_t& slot) const;
+    void grow();
+
+    std::vector<char> bytes_;
+    std::vector<uint32_t> offsets_;  // offsets_[id] = start of string id; one extra end sentinel
+    std::vector<StringId> slots_;    // open-addressing hash table of ids, power-of-two sized
+};
+
+#endif // STRINGPOOL_H_INCLUDED
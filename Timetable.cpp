@@ -0,0 +1,478 @@
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <limits>
+#include <cmath>
+#include "Timetable.h"
+#include "GtfsParser.h"
+#include "SimdKernels.h"
+#include "Raptor.h"
+#include "Logger.h"
+
+static int floorDiv(int a, int b) {
+    return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
+
+void RoutePattern::serviceDays(int window_start, int window_end, int& first_day, int& last_day) const {
+    int earliest_departure = departureColumn(0)[0];
+    int latest_arrival = arrival(tripCount() - 1, stopCount() - 1);
+    first_day = floorDiv(window_start - latest_arrival, SECONDS_PER_DAY);
+    last_day = floorDiv(window_end - earliest_departure, SECONDS_PER_DAY);
+}
+
+bool RoutePattern::earliestTrip(int position, int time, int first_day, int last_day, int& trip, int& shift) const {
+    const int32_t* column = departureColumn(position);
+    bool found = false;
+    int best_departure = 0;
+    for (int day = first_day; day <= last_day; ++day) {
+        int day_shift = day * SECONDS_PER_DAY;
+        int index = firstAtLeast(column, tripCount(), time - day_shift);
+        if (index == tripCount()) continue;
+        int departure = column[index] + day_shift;
+        if (!found || departure < best_departure) {
+            found = true;
+            best_departure = departure;
+            trip = index;
+            shift = day_shift;
+        }
+    }
+    return found;
+}
+
+// A parsed stop_times row whose trip id still points into the mapped file
+struct StagedStopTime {
+    FieldView trip;
+    StopTime stop_time;
+};
+
+// Parses stop_times.txt straight from a mapped view of the file. Chunks are parsed in parallel
+// into per-chunk vectors, then trip ids are interned and rows moved into trips_map in file order.
+static void loadStopTimes(const std::string& path, StringPool& strings, std::map<StringId, std::vector<StopTime>>& trips_map) {
+    MappedFile file(path);
+    if (!file.isOpen()) throw std::runtime_error("cannot open " + path);
+    const char* end = file.data() + file.size();
+    CsvHeader header;
+    const char* body = header.parse(file.data(), end);
+    const int trip_col = header.requireColumn("stop_times.txt", {"trip_id"});
+    const int arrival_col = header.requireColumn("stop_times.txt", {"arrival_time"});
+    const int departure_col = header.requireColumn("stop_times.txt", {"departure_time"});
+    const int stop_col = header.requireColumn("stop_times.txt", {"stop_id"});
+    const int sequence_col = header.requireColumn("stop_times.txt", {"stop_sequence"});
+    const int min_fields = 1 + std::max({trip_col, arrival_col, departure_col, stop_col, sequence_col});
+
+    std::vector<std::vector<StagedStopTime>> chunk_rows(std::max(1u, std::thread::hardware_concurrency()));
+    size_t chunk_count = forEachChunkParallel(body, end, [&](size_t chunk, const char* begin, const char* chunk_end) {
+        auto& rows = chunk_rows[chunk];
+        rows.reserve(static_cast<size_t>(chunk_end - begin) / 40); // ~40 bytes per row in typical feeds
+        forEachRow(begin, chunk_end, header.width(), [&](const FieldView* fields, int count) {
+            StagedStopTime row;
+            StopTime& st = row.stop_time;
+            if (count >= min_fields &&
+                parseTime(fields[arrival_col], st.arrival_time) && parseTime(fields[departure_col], st.departure_time) &&
+                parseInt(fields[stop_col], st.stop_id) && st.stop_id >= 0 && parseInt(fields[sequence_col], st.stop_sequence)) {
+                row.trip = fields[trip_col];
+                rows.push_back(row);
+            }
+        });
+    });
+
+    // stop_times.txt is normally grouped by trip, so only intern when the trip id changes
+    std::vector<StopTime>* current = nullptr;
+    FieldView current_trip;
+    StringId current_id = NO_STRING;
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+        for (auto& row : chunk_rows[chunk]) {
+            if (!current || row.trip.size() != current_trip.size() ||
+                !std::equal(row.trip.begin, row.trip.end, current_trip.begin)) {
+                current_trip = row.trip;
+                current_id = strings.intern(row.trip.begin, row.trip.end);
+                current = &trips_map[current_id];
+            }
+            row.stop_time.trip_id = current_id;
+            current->push_back(row.stop_time);
+        }
+        std::vector<StagedStopTime>().swap(chunk_rows[chunk]);
+    }
+}
+
+// stop_lat/stop_lon are optional; stops without them are routable but never walked to or from
+static void loadStops(const std::string& path, StringPool& strings, std::map<int, Stop>& stops) {
+    MappedFile file(path);
+    if (!file.isOpen()) throw std::runtime_error("cannot open " + path);
+    const char* end = file.data() + file.size();
+    CsvHeader header;
+    const char* body = header.parse(file.data(), end);
+    const int id_col = header.requireColumn("stops.txt", {"stop_id"});
+    const int name_col = header.column({"stop_name"});
+    const int lat_col = header.column({"stop_lat"});
+    const int lon_col = header.column({"stop_lon"});
+    const int zone_col = header.column({"zone_id"});
+
+    forEachRow(body, end, header.width(), [&](const FieldView* fields, int count) {
+        Stop s;
+        // This safely skips any lines with bad data
+        if (id_col >= count || !parseInt(fields[id_col], s.id) || s.id < 0) return;
+        if (name_col >= 0 && name_col < count) s.name = strings.intern(fields[name_col].begin, fields[name_col].end);
+        if (lat_col >= 0 && lon_col >= 0 && lat_col < count && lon_col < count) {
+            s.has_location = parseDouble(fields[lat_col], s.lat) && parseDouble(fields[lon_col], s.lon);
+        }
+        if (zone_col >= 0 && zone_col < count && !fields[zone_col].empty()) s.zone_id = strings.intern(fields[zone_col].begin, fields[zone_col].end);
+        stops[s.id] = s;
+    });
+}
+
+// transfers.txt is optional. The standard duration column is min_transfer_time; older copies of
+// our feed call it transfer_time_seconds.
+static void loadTransfers(const std::string& path, std::map<int, std::vector<Transfer>>& transfers_map) {
+    MappedFile file(path);
+    if (!file.isOpen()) return;
+    const char* end = file.data() + file.size();
+    CsvHeader header;
+    const char* body = header.parse(file.data(), end);
+    const int from_col = header.requireColumn("transfers.txt", {"from_stop_id"});
+    const int to_col = header.requireColumn("transfers.txt", {"to_stop_id"});
+    const int duration_col = header.column({"min_transfer_time", "transfer_time_seconds"});
+
+    forEachRow(body, end, header.width(), [&](const FieldView* fields, int count) {
+        Transfer t;
+        t.duration_seconds = 0;
+        if (from_col >= count || to_col >= count ||
+            !parseInt(fields[from_col], t.from_stop_id) || !parseInt(fields[to_col], t.to_stop_id) ||
+            t.from_stop_id < 0 || t.to_stop_id < 0) return;
+        if (duration_col >= 0 && duration_col < count && !fields[duration_col].empty()) parseInt(fields[duration_col], t.duration_seconds);
+        transfers_map[t.from_stop_id].push_back(t);
+    });
+}
+
+// trips.txt is optional; it only supplies each trip's route_id
+static void loadTripRoutes(const std::string& path, StringPool& strings, std::map<StringId, StringId>& trip_routes) {
+    MappedFile file(path);
+    if (!file.isOpen()) return;
+    const char* end = file.data() + file.size();
+    CsvHeader header;
+    const char* body = header.parse(file.data(), end);
+    const int trip_col = header.requireColumn("trips.txt", {"trip_id"});
+    const int route_col = header.requireColumn("trips.txt", {"route_id"});
+
+    forEachRow(body, end, header.width(), [&](const FieldView* fields, int count) {
+        if (trip_col >= count || route_col >= count || fields[trip_col].empty()) return;
+        trip_routes[strings.intern(fields[trip_col].begin, fields[trip_col].end)] = strings.intern(fields[route_col].begin, fields[route_col].end);
+    });
+}
+
+// routes.txt is optional; it only supplies display names for route ids
+static void loadRouteNames(const std::string& path, StringPool& strings, std::map<StringId, StringId>& route_names) {
+    MappedFile file(path);
+    if (!file.isOpen()) return;
+    const char* end = file.data() + file.size();
+    CsvHeader header;
+    const char* body = header.parse(file.data(), end);
+    const int route_col = header.requireColumn("routes.txt", {"route_id"});
+    const int short_col = header.column({"route_short_name"});
+    const int long_col = header.column({"route_long_name"});
+
+    forEachRow(body, end, header.width(), [&](const FieldView* fields, int count) {
+        if (route_col >= count || fields[route_col].empty()) return;
+        FieldView name;
+        if (short_col >= 0 && short_col < count && !fields[short_col].empty()) name = fields[short_col];
+        else if (long_col >= 0 && long_col < count && !fields[long_col].empty()) name = fields[long_col];
+        else return;
+        route_names[strings.intern(fields[route_col].begin, fields[route_col].end)] = strings.intern(name.begin, name.end);
+    });
+}
+
+// `file` inside `dir`, which may or may not end in a separator; "" is the working directory
+static std::string feedPath(const std::string& dir, const char* file) {
+    if (dir.empty() || dir.back() == '/' || dir.back() == '\\') return dir + file;
+    return dir + "/" + file;
+}
+
+// fare_attributes.txt gives each fare_id a price and fare_rules.txt says where it applies (route,
+// origin zone, destination zone; contains_id is not supported). A feed with prices but no rules
+// has one flat fare for every leg.
+static void loadFares(const std::string& data_dir, StringPool& strings, std::vector<FareRule>& fare_rules) {
+    MappedFile attributes(feedPath(data_dir, "fare_attributes.txt"));
+    if (!attributes.isOpen()) return;
+    std::map<std::string, int> prices;
+    const char* end = attributes.data() + attributes.size();
+    CsvHeader header;
+    const char* body = header.parse(attributes.data(), end);
+    const int fare_col = header.requireColumn("fare_attributes.txt", {"fare_id"});
+    const int price_col = header.requireColumn("fare_attributes.txt", {"price"});
+    forEachRow(body, end, header.width(), [&](const FieldView* fields, int count) {
+        double price;
+        if (fare_col >= count || price_col >= count || !parseDouble(fields[price_col], price)) return;
+        prices[fields[fare_col].str()] = static_cast<int>(std::lround(price * 100.0));
+    });
+
+    MappedFile rules(feedPath(data_dir, "fare_rules.txt"));
+    if (!rules.isOpen()) {
+        for (const auto& price : prices) {
+            FareRule rule;
+            rule.price = price.second;
+            fare_rules.push_back(rule);
+        }
+        return;
+    }
+    end = rules.data() + rules.size();
+    body = header.parse(rules.data(), end);
+    const int rule_fare_col = header.requireColumn("fare_rules.txt", {"fare_id"});
+    const int route_col = header.column({"route_id"});
+    const int origin_col = header.column({"origin_id"});
+    const int destination_col = header.column({"destination_id"});
+    auto optionalId = [&](const FieldView* fields, int count, int col) {
+        return (col >= 0 && col < count && !fields[col].empty()) ? strings.intern(fields[col].begin, fields[col].end) : NO_STRING;
+    };
+    forEachRow(body, end, header.width(), [&](const FieldView* fields, int count) {
+        if (rule_fare_col >= count) return;
+        auto price = prices.find(fields[rule_fare_col].str());
+        if (price == prices.end()) return;
+        FareRule rule;
+        rule.route_id = optionalId(fields, count, route_col);
+        rule.origin_zone = optionalId(fields, count, origin_col);
+        rule.destination_zone = optionalId(fields, count, destination_col);
+        rule.price = price->second;
+        fare_rules.push_back(rule);
+    });
+}
+
+int Timetable::legFare(const RoutePattern& pattern, int board_position, int alight_position) const {
+    if (pattern.fare_rules.empty()) return 0;
+    StringId origin_zone = pattern.zone(board_position);
+    StringId destination_zone = pattern.zone(alight_position);
+    int cheapest = -1;
+    for (int index : pattern.fare_rules) {
+        const FareRule& rule = fare_rules[index];
+        if (rule.origin_zone != NO_STRING && rule.origin_zone != origin_zone) continue;
+        if (rule.destination_zone != NO_STRING && rule.destination_zone != destination_zone) continue;
+        if (cheapest == -1 || rule.price < cheapest) cheapest = rule.price;
+    }
+    return cheapest == -1 ? 0 : cheapest;
+}
+
+// True if trip `b` never departs or arrives before trip `a` at any position
+static bool keepsOrder(const std::vector<StopTime>& a, const std::vector<StopTime>& b) {
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (b[i].departure_time < a[i].departure_time || b[i].arrival_time < a[i].arrival_time) return false;
+    }
+    return true;
+}
+
+// Groups trips with the same stop sequence into RoutePatterns. A group is split further wherever a
+// trip would overtake another, so every pattern is ordered by departure at all positions.
+static void buildPatterns(std::map<StringId, std::vector<StopTime>>& trips_map, const std::map<StringId, StringId>& trip_routes,
+                          Timetable& timetable) {
+    std::map<std::pair<StringId, std::vector<int>>, std::vector<const std::vector<StopTime>*>> trips_by_sequence;
+    for (auto& pair : trips_map) {
+        auto& schedule = pair.second;
+        std::sort(schedule.begin(), schedule.end(), [](const StopTime& a, const StopTime& b) { return a.stop_sequence < b.stop_sequence; });
+        std::vector<int> sequence;
+        sequence.reserve(schedule.size());
+        for (const auto& st : schedule) sequence.push_back(st.stop_id);
+        auto route = trip_routes.find(pair.first);
+        trips_by_sequence[{route != trip_routes.end() ? route->second : NO_STRING, sequence}].push_back(&schedule);
+    }
+
+    for (auto& group : trips_by_sequence) {
+        auto& trips = group.second;
+        std::sort(trips.begin(), trips.end(), [](const std::vector<StopTime>* a, const std::vector<StopTime>* b) {
+            return a->front().departure_time < b->front().departure_time;
+        });
+        std::vector<std::vector<const std::vector<StopTime>*>> fifo_groups;
+        for (const auto* trip : trips) {
+            bool placed = false;
+            for (auto& fifo : fifo_groups) {
+                if (keepsOrder(*fifo.back(), *trip)) {
+                    fifo.push_back(trip);
+                    placed = true;
+                    break;
+                }
+            }
+            if (!placed) fifo_groups.push_back({trip});
+        }
+
+        for (const auto& fifo : fifo_groups) {
+            RoutePattern pattern;
+            pattern.route_id = group.first.first;
+            pattern.stops = group.first.second;
+            for (size_t i = 0; i < timetable.fare_rules.size(); ++i) {
+                StringId rule_route = timetable.fare_rules[i].route_id;
+                if (rule_route == NO_STRING || rule_route == pattern.route_id) pattern.fare_rules.push_back(static_cast<int>(i));
+            }
+            // Zones are only needed to pick fares; a stop missing from stops.txt has none
+            if (!pattern.fare_rules.empty()) {
+                for (int stop_id : pattern.stops) {
+                    auto stop = timetable.stops.find(stop_id);
+                    pattern.zones.push_back(stop != timetable.stops.end() ? stop->second.zone_id : NO_STRING);
+                }
+            }
+            size_t stop_count = pattern.stops.size();
+            size_t trip_count = fifo.size();
+            pattern.arrivals.reserve(trip_count * stop_count);
+            pattern.departures.reserve(trip_count * stop_count);
+            pattern.departures_by_stop.resize(trip_count * stop_count);
+            for (size_t t = 0; t < trip_count; ++t) {
+                const auto& schedule = *fifo[t];
+                pattern.trip_ids.push_back(schedule.front().trip_id);
+                for (size_t p = 0; p < stop_count; ++p) {
+                    pattern.arrivals.push_back(schedule[p].arrival_time.toSeconds());
+                    pattern.departures.push_back(schedule[p].departure_time.toSeconds());
+                    pattern.departures_by_stop[p * trip_count + t] = schedule[p].departure_time.toSeconds();
+                }
+            }
+            int pattern_index = static_cast<int>(timetable.patterns.size());
+            for (size_t p = 0; p < stop_count; ++p) {
+                timetable.patterns_serving_stop[pattern.stops[p]].push_back({pattern_index, static_cast<int>(p)});
+            }
+            timetable.patterns.push_back(std::move(pattern));
+        }
+    }
+    // Growth slack would otherwise be kept for the timetable's lifetime
+    timetable.patterns.shrink_to_fit();
+    for (auto& pair : timetable.patterns_serving_stop) pair.second.shrink_to_fit();
+}
+
+template <typename T>
+static size_t vectorBytes(const std::vector<T>& values) {
+    return values.capacity() * sizeof(T);
+}
+
+template <typename K, typename V>
+static size_t mapBytes(const std::map<K, V>& map) {
+    return map.size() * (sizeof(typename std::map<K, V>::value_type) + 4 * sizeof(void*));
+}
+
+std::vector<MemoryUsage> memoryReport(const Timetable& timetable) {
+    std::vector<MemoryUsage> report;
+    report.push_back({"strings", timetable.strings.size(), timetable.strings.bytesUsed(), true});
+    report.push_back({"stops", timetable.stops.size(), mapBytes(timetable.stops), true});
+
+    MemoryUsage transfers = {"transfers_map", 0, mapBytes(timetable.transfers_map), true};
+    for (const auto& pair : timetable.transfers_map) {
+        transfers.elements += pair.second.size();
+        transfers.bytes += vectorBytes(pair.second);
+    }
+    report.push_back(transfers);
+
+    // Stop events are split out: they grow with the timetable, the rest with the network
+    MemoryUsage patterns = {"patterns", timetable.patterns.size(), vectorBytes(timetable.patterns), true};
+    MemoryUsage stop_events = {"pattern_stop_events", 0, 0, true};
+    for (const auto& pattern : timetable.patterns) {
+        patterns.bytes += vectorBytes(pattern.fare_rules) + vectorBytes(pattern.stops) + vectorBytes(pattern.zones) + vectorBytes(pattern.trip_ids);
+        stop_events.elements += pattern.arrivals.size();
+        stop_events.bytes += vectorBytes(pattern.arrivals) + vectorBytes(pattern.departures) + vectorBytes(pattern.departures_by_stop);
+    }
+    report.push_back(patterns);
+    report.push_back(stop_events);
+
+    MemoryUsage serving = {"patterns_serving_stop", 0, mapBytes(timetable.patterns_serving_stop), true};
+    for (const auto& pair : timetable.patterns_serving_stop) {
+        serving.elements += pair.second.size();
+        serving.bytes += vectorBytes(pair.second);
+    }
+    report.push_back(serving);
+
+    report.push_back({"stop_coordinates", timetable.stop_lats.size(), vectorBytes(timetable.stop_lats) + vectorBytes(timetable.stop_lons), true});
+    report.push_back({"fare_rules", timetable.fare_rules.size(), vectorBytes(timetable.fare_rules), true});
+    report.push_back({"route_names", timetable.route_names.size(), mapBytes(timetable.route_names), true});
+    report.push_back({"stop_times_staging", timetable.staging_stop_times, timetable.staging_bytes, false});
+    return report;
+}
+
+size_t residentBytes(const std::vector<MemoryUsage>& report) {
+    size_t total = 0;
+    for (const auto& usage : report) {
+        if (usage.resident) total += usage.bytes;
+    }
+    return total;
+}
+
+std::shared_ptr<const Timetable> loadTimetable(const std::string& data_dir, int version) {
+    auto timetable = std::make_shared<Timetable>();
+    timetable->version = version;
+
+    // Per-trip stop times are only staging data; the engine runs on the patterns built from them
+    std::map<StringId, std::vector<StopTime>> trips_map;
+    std::map<StringId, StringId> trip_routes;
+    loadStops(feedPath(data_dir, "stops.txt"), timetable->strings, timetable->stops);
+    loadStopTimes(feedPath(data_dir, "stop_times.txt"), timetable->strings, trips_map);
+    loadTripRoutes(feedPath(data_dir, "trips.txt"), timetable->strings, trip_routes);
+    loadRouteNames(feedPath(data_dir, "routes.txt"), timetable->strings, timetable->route_names);
+    loadTransfers(feedPath(data_dir, "transfers.txt"), timetable->transfers_map);
+    loadFares(data_dir, timetable->strings, timetable->fare_rules);
+    buildPatterns(trips_map, trip_routes, *timetable);
+
+    // The staging maps are freed as soon as the patterns exist, before anything else is built,
+    // so they do not add to the peak together with the per-stop arrays below
+    timetable->trip_count = trips_map.size();
+    timetable->staging_bytes = mapBytes(trips_map) + mapBytes(trip_routes);
+    for (const auto& pair : trips_map) {
+        timetable->staging_stop_times += pair.second.size();
+        timetable->staging_bytes += vectorBytes(pair.second);
+    }
+    trips_map.clear();
+    trip_routes.clear();
+
+    // Walked distance of each transfer, for the walking criterion; estimated from its duration
+    // when either stop has no coordinates
+    for (auto& pair : timetable->transfers_map) {
+        pair.second.shrink_to_fit();
+        for (auto& transfer : pair.second) {
+            auto from = timetable->stops.find(transfer.from_stop_id);
+            auto to = timetable->stops.find(transfer.to_stop_id);
+            if (from != timetable->stops.end() && to != timetable->stops.end() && from->second.has_location && to->second.has_location) {
+                transfer.distance_meters = static_cast<int>(haversine(from->second.lat, from->second.lon, to->second.lat, to->second.lon));
+            } else {
+                transfer.distance_meters = static_cast<int>(transfer.duration_seconds * WALKING_SPEED_MPS);
+            }
+        }
+    }
+    for (const auto& pair : timetable->stops) timetable->stop_id_limit = std::max(timetable->stop_id_limit, pair.first + 1);
+    for (const auto& pair : timetable->patterns_serving_stop) timetable->stop_id_limit = std::max(timetable->stop_id_limit, pair.first + 1);
+    for (const auto& pair : timetable->transfers_map) {
+        for (const auto& transfer : pair.second) timetable->stop_id_limit = std::max(timetable->stop_id_limit, std::max(transfer.from_stop_id, transfer.to_stop_id) + 1);
+    }
+    timetable->stop_lats.assign(timetable->stop_id_limit, std::numeric_limits<float>::quiet_NaN());
+    timetable->stop_lons.assign(timetable->stop_id_limit, std::numeric_limits<float>::quiet_NaN());
+    for (const auto& pair : timetable->stops) {
+        if (!pair.second.has_location) continue;
+        timetable->stop_lats[pair.first] = static_cast<float>(pair.second.lat);
+        timetable->stop_lons[pair.first] = static_cast<float>(pair.second.lon);
+    }
+
+    if (timetable->stops.empty() || timetable->trip_count == 0) throw std::runtime_error("feed in '" + data_dir + "' has no usable stops or trips");
+    return timetable;
+}
+
+bool TimetableStore::reloadAsync() {
+    bool expected = false;
+    if (!reloading_.compare_exchange_strong(expected, true)) return false;
+
+    std::thread([this]() {
+        auto old_timetable = current();
+        int next_version = old_timetable ? old_timetable->version + 1 : 1;
+        try {
+            auto fresh = loadTimetable(data_dir_, next_version);
+            publish(fresh);
+            {
+                std::lock_guard<std::mutex> lock(error_mutex_);
+                last_error_.clear();
+            }
+            LogLine(LOG_INFO, "timetable_reloaded").field("version", next_version)
+                .field("resident_bytes", static_cast<uint64_t>(residentBytes(memoryReport(*fresh))))
+                .field("staging_bytes", static_cast<uint64_t>(fresh->staging_bytes));
+        } catch (const std::exception& e) {
+            // Keep serving the previous timetable
+            std::lock_guard<std::mutex> lock(error_mutex_);
+            last_error_ = e.what();
+            LogLine(LOG_ERROR, "timetable_reload_failed").field("error", e.what());
+        }
+        reloading_ = false;
+    }).detach();
+    return true;
+}
+
+std::string TimetableStore::lastError() const {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    return last_error_;
+}
@@ -0,0 +1,123 @@
+#ifndef TIMETABLE_H_INCLUDED
+#define TIMETABLE_H_INCLUDED
+
+#include <map>
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include "DataTypes.h"
+#include "StringPool.h"
+
+// Trips that visit exactly the same stop sequence and never overtake each other, so trips are
+// ordered by departure at every position. Stop events are plain seconds since the start of the
+// trip's service day, stored trip-major (trip * stopCount() + position) for scanning along a
+// trip, plus a position-major copy of departures for finding the earliest catchable trip.
+struct RoutePattern {
+    StringId route_id = NO_STRING;           // from trips.txt, if the feed has one
+    std::vector<int> fare_rules;             // indices of Timetable::fare_rules that can apply
+    std::vector<int> stops;                  // stop ids in visiting order
+    std::vector<StringId> zones;             // fare zone at each position; empty without fare_rules
+    std::vector<StringId> trip_ids;          // in departure order
+    std::vector<int32_t> arrivals;           // trip-major
+    std::vector<int32_t> departures;         // trip-major
+    std::vector<int32_t> departures_by_stop; // position-major: position * tripCount() + trip
+
+    int stopCount() const { return static_cast<int>(stops.size()); }
+    int tripCount() const { return static_cast<int>(trip_ids.size()); }
+    int32_t arrival(int trip, int position) const { return arrivals[static_cast<size_t>(trip) * stops.size() + position]; }
+    int32_t departure(int trip, int position) const { return departures[static_cast<size_t>(trip) * stops.size() + position]; }
+    StringId zone(int position) const { return zones.empty() ? NO_STRING : zones[position]; }
+    // Departures of every trip at one position, in trip order (non-decreasing)
+    const int32_t* departureColumn(int position) const { return departures_by_stop.data() + static_cast<size_t>(position) * trip_ids.size(); }
+
+    // Service days (relative to the query day) whose run of this pattern overlaps the window
+    void serviceDays(int window_start, int window_end, int& first_day, int& last_day) const;
+    // Finds the earliest trip leaving `position` at or after `time`. Trips repeat every service
+    // day in [first_day, last_day], so each day is searched with its times shifted; the arrays
+    // themselves are never duplicated. Returns false if nothing can be caught.
+    bool earliestTrip(int position, int time, int first_day, int last_day, int& trip, int& shift) const;
+};
+
+// A priced fare_rules.txt row. NO_STRING fields match anything.
+struct FareRule {
+    StringId route_id = NO_STRING;
+    StringId origin_zone = NO_STRING;
+    StringId destination_zone = NO_STRING;
+    int price = 0; // minor currency units
+};
+
+// One place a pattern visits a stop
+struct PatternStop {
+    int pattern;
+    int position;
+};
+
+// Immutable snapshot of one loaded GTFS feed. Requests hold a shared_ptr to the snapshot they
+// started on, so a reload can publish a new one while in-flight queries finish on the old one.
+struct Timetable {
+    StringPool strings; // trip ids, route ids, stop names and zones
+    std::map<int, Stop> stops;
+    std::map<int, std::vector<Transfer>> transfers_map;
+    std::vector<RoutePattern> patterns;
+    std::map<int, std::vector<PatternStop>> patterns_serving_stop;
+    size_t trip_count = 0;
+    int stop_id_limit = 0; // one past the largest stop id; the size of per-stop arrays
+    // Stop coordinates in degrees indexed by stop id, NaN where unknown, for batch distance kernels
+    std::vector<float> stop_lats;
+    std::vector<float> stop_lons;
+    std::vector<FareRule> fare_rules;
+    std::map<StringId, StringId> route_names; // route_id -> short (or else long) name from routes.txt
+    int version = 0;
+    // Per-trip stop times the patterns were built from; freed once loading is done
+    size_t staging_stop_times = 0;
+    size_t staging_bytes = 0;
+
+    // Cheapest fare for riding `pattern` between two of its positions; 0 if the feed has no fare for it
+    int legFare(const RoutePattern& pattern, int board_position, int alight_position) const;
+};
+
+// Estimated heap footprint of one structure. Vectors count their capacity; map entries count
+// the value plus the tree node's color and three pointers, but not allocator padding.
+struct MemoryUsage {
+    const char* structure;
+    size_t elements;
+    size_t bytes;
+    bool resident; // false for staging data that was already freed
+};
+
+// Footprint of every structure of `timetable`, in declaration order
+std::vector<MemoryUsage> memoryReport(const Timetable& timetable);
+// Sum of the resident entries of a report
+size_t residentBytes(const std::vector<MemoryUsage>& report);
+
+// Loads and pre-processes the GTFS files in data_dir, with or without a trailing separator. Throws std::runtime_error if the feed
+// is missing its required files.
+std::shared_ptr<const Timetable> loadTimetable(const std::string& data_dir, int version);
+
+// Owns the currently published timetable and swaps in reloaded ones atomically
+class TimetableStore {
+public:
+    explicit TimetableStore(std::string data_dir) : data_dir_(std::move(data_dir)) {}
+
+    std::shared_ptr<const Timetable> current() const { return std::atomic_load(&current_); }
+    void publish(std::shared_ptr<const Timetable> timetable) { std::atomic_store(&current_, std::move(timetable)); }
+
+    // Builds a new timetable on a background thread and publishes it when done.
+    // Returns false if a reload is already running.
+    bool reloadAsync();
+    bool reloading() const { return reloading_; }
+    std::string lastError() const;
+    const std::string& dataDir() const { return data_dir_; }
+
+private:
+    std::string data_dir_;
+    std::shared_ptr<const Timetable> current_;
+    std::atomic<bool> reloading_{false};
+    mutable std::mutex error_mutex_;
+    std::string last_error_;
+};
+
+#endif // TIMETABLE_H_INCLUDED
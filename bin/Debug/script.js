@@ -87,7 +87,7 @@ document.addEventListener('DOMContentLoaded', () => {
     });
 
     // --- Route Drawing and Results Display ---
-    function drawRouteOnMap(path) {
+    function drawRouteOnMap(legs) {
         if (currentRouteLayer) map.removeLayer(currentRouteLayer);
         const routeLayers = [];
         let fullPathCoords = [];
@@ -98,21 +98,24 @@ document.addEventListener('DOMContentLoaded', () => {
         let lastCoords = startMarker.getLatLng();
         fullPathCoords.push(lastCoords);
 
-        path.forEach(step => {
-            const currentMarker = stopMarkers[step.stop_id];
-            if (currentMarker) {
-                const currentCoords = currentMarker.getLatLng();
-                const segmentCoords = [lastCoords, currentCoords];
-                const isWalk = step.method === "Walk";
-
+        legs.forEach(leg => {
+            const isWalk = leg.mode === "walk";
+            // Trip legs are drawn through the stops they pass
+            const stopIds = (leg.stops || []).map(stop => stop.stop_id).concat([leg.to_stop_id]);
+            const segmentCoords = [lastCoords];
+            stopIds.forEach(stopId => {
+                const currentMarker = stopMarkers[stopId];
+                if (currentMarker) segmentCoords.push(currentMarker.getLatLng());
+            });
+            if (segmentCoords.length > 1) {
                 const polyline = L.polyline(segmentCoords, {
                     color: isWalk ? '#f542a4' : '#1a73e8',
                     weight: isWalk ? 4 : 6,
                     dashArray: isWalk ? '5, 10' : null
                 });
                 routeLayers.push(polyline);
-                fullPathCoords.push(currentCoords);
-                lastCoords = currentCoords;
+                fullPathCoords = fullPathCoords.concat(segmentCoords.slice(1));
+                lastCoords = segmentCoords[segmentCoords.length - 1];
             }
         });
 
@@ -142,7 +145,7 @@ document.addEventListener('DOMContentLoaded', () => {
             row.innerHTML = `<td><b>${result.arrival_time}</b></td><td>${formatDuration(travelSeconds)}</td><td>${result.trips}</td>`;
             row.style.cursor = 'pointer';
             row.addEventListener('click', () => {
-                if(result.path) drawRouteOnMap(result.path);
+                if(result.legs) drawRouteOnMap(result.legs);
                 tbody.querySelectorAll('tr').forEach(r => r.style.backgroundColor = '');
                 row.style.backgroundColor = '#dde7f5';
             });
@@ -162,7 +165,7 @@ document.addEventListener('DOMContentLoaded', () => {
         if (currentRouteLayer) map.removeLayer(currentRouteLayer);
 
         try {
-            const response = await fetch(`/api/route?from=${selectedStartId}&to=${selectedEndId}&time=${time}`);
+            const response = await fetch(`/api/route?from=${selectedStartId}&to=${selectedEndId}&time=${time}&stops=1`);
             const routeData = await response.json();
             displayResults(routeData);
         } catch (error) {
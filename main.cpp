@@ -1,16 +1,35 @@
+#ifdef _WIN32
 #define _WIN32_WINNT 0x0A00 // We are targeting Windows 10 or later
+#endif
 
 #include <iostream>
 #include <vector>
 #include <string>
-#include <fstream>
 #include <sstream>
 #include <map>
 #include <algorithm>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
 
 #include "httplib.h" // The web server library
 #include "DataTypes.h"
 #include "Raptor.h"
+#include "Timetable.h"
+#include "SimdKernels.h"
+#include "JsonWriter.h"
+#include "JsonReader.h"
+#include "Metrics.h"
+#include "Logger.h"
+#include "EpollServer.h"
+#include "Config.h"
 
 // Helper function implementations that were previously in main.cpp
 std::ostream& operator<<(std::ostream& os, const Time& t) {
@@ -20,169 +39,676 @@ std::ostream& operator<<(std::ostream& os, const Time& t) {
     return os;
 }
 
-std::string getStopName(int stop_id, const std::map<int, Stop>& stops) {
-    auto it = stops.find(stop_id);
-    return (it != stops.end()) ? it->second.name : "Unknown Stop";
+const char* getStopName(int stop_id, const Timetable& timetable) {
+    auto it = timetable.stops.find(stop_id);
+    if (it == timetable.stops.end()) return "Unknown Stop";
+    return it->second.name == NO_STRING ? "" : timetable.strings.c_str(it->second.name);
 }
 
+// Writes an interned string straight from the pool; NO_STRING becomes ""
+void writePooled(JsonWriter& json, const StringPool& strings, StringId id) {
+    if (id == NO_STRING) json.string("", 0);
+    else json.string(strings.c_str(id), strings.length(id));
+}
+
+void sendError(httplib::Response& res, int status, const std::string& message) {
+    std::string body;
+    JsonWriter(body).beginObject().key("error").string(message).endObject();
+    res.status = status;
+    res.set_content(std::move(body), "application/json");
+}
+
+// Error messages for a request number that is malformed or out of range
+std::string intRangeError(const char* name, int min, int max) {
+    return std::string("Invalid ") + name + ": expected a whole number " +
+           (max == INT_MAX ? "of at least " + std::to_string(min) : "from " + std::to_string(min) + " to " + std::to_string(max));
+}
+std::string numberError(const char* name) {
+    return std::string("Invalid ") + name + ": expected a non-negative number";
+}
+
+// Reads the URL parameter `name`, if present, into `value`. Sends a 400 naming the parameter and
+// returns false unless it is a whole number from min to max.
+bool intParam(const httplib::Request& req, httplib::Response& res, const char* name, int min, int max, int& value) {
+    if (!req.has_param(name)) return true;
+    const std::string text = req.get_param_value(name);
+    char* end = nullptr;
+    errno = 0;
+    long number = std::strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end || errno || number < min || number > max) {
+        sendError(res, 400, intRangeError(name, min, max));
+        return false;
+    }
+    value = static_cast<int>(number);
+    return true;
+}
+
+// Same for a non-negative number such as a distance
+bool numberParam(const httplib::Request& req, httplib::Response& res, const char* name, double& value) {
+    if (!req.has_param(name)) return true;
+    const std::string text = req.get_param_value(name);
+    char* end = nullptr;
+    errno = 0;
+    double number = std::strtod(text.c_str(), &end);
+    if (text.empty() || *end || errno || !std::isfinite(number) || number < 0) {
+        sendError(res, 400, numberError(name));
+        return false;
+    }
+    value = number;
+    return true;
+}
+
+// Writes one leg of a /api/route result
+void writeLeg(JsonWriter& json, const JourneyLeg& leg, const Timetable& timetable) {
+    json.beginObject()
+        .key("mode").string(leg.method == METHOD_TRIP ? "trip" : "walk")
+        .key("from_stop_id").number(leg.from_stop_id).key("from_stop_name").string(getStopName(leg.from_stop_id, timetable))
+        .key("departure_time").time(leg.departure_time)
+        .key("to_stop_id").number(leg.to_stop_id).key("to_stop_name").string(getStopName(leg.to_stop_id, timetable))
+        .key("arrival_time").time(leg.arrival_time);
+    if (leg.method == METHOD_TRIP) {
+        auto route_name = timetable.route_names.find(leg.route_id);
+        json.key("trip_id");
+        writePooled(json, timetable.strings, leg.trip_id);
+        json.key("route_id");
+        writePooled(json, timetable.strings, leg.route_id);
+        json.key("route_name");
+        writePooled(json, timetable.strings, route_name != timetable.route_names.end() ? route_name->second : NO_STRING);
+    } else {
+        json.key("walk_meters").number(leg.walk_meters);
+    }
+    if (!leg.stops.empty()) {
+        json.key("stops").beginArray();
+        for (const auto& stop : leg.stops) {
+            json.beginObject()
+                .key("stop_id").number(stop.stop_id).key("stop_name").string(getStopName(stop.stop_id, timetable))
+                .key("arrival_time").time(stop.arrival_time).key("departure_time").time(stop.departure_time)
+                .endObject();
+        }
+        json.endArray();
+    }
+    json.endObject();
+}
+
+// One route query, from the /api/route URL parameters or one element of a batch
+struct RouteQuery {
+    int from = 0;
+    int to = 0;
+    Time time;
+    int horizon_seconds = DEFAULT_HORIZON_SECONDS;
+    RaptorCriteria criteria;
+    bool with_stops = false;
+    bool explain = false;
+    // Engine limits asked for by the request, -1 if not given; see queryLimits
+    int rounds = -1;
+    double walk_meters = -1;
+    int budget_ms = -1;
+};
+
+// Optional search horizon in hours; lets late-evening queries continue into the next service day
+int horizonSeconds(int horizon_hours, const ServerConfig& config) {
+    return std::max(1, std::min(horizon_hours, config.max_horizon_hours)) * 3600;
+}
+
+// Parses a comma-separated criteria list such as "walking,fare". Returns false and the offending
+// name if one is not known.
+bool parseCriteria(const std::string& list, RaptorCriteria& criteria, std::string& unknown) {
+    std::stringstream names(list);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        if (name == "walking") criteria.walking = true;
+        else if (name == "fare") criteria.fare = true;
+        else {
+            unknown = name;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Writes the "explain" member of a result: phase times and the work done in every round
+void writeExplain(JsonWriter& json, const RaptorStats& stats, const RaptorExplain& explain) {
+    json.key("explain").beginObject()
+        .key("seeding_us").number(explain.seeding_micros).key("rounds_us").number(explain.rounds_micros)
+        .key("finalization_us").number(explain.finalization_micros).key("reconstruction_us").number(explain.reconstruction_micros)
+        .key("labels_created").number(stats.labels_created);
+    json.key("rounds").beginArray();
+    for (const auto& round : explain.rounds) {
+        json.beginObject()
+            .key("marked_stops").number(round.marked_stops).key("patterns_scanned").number(round.patterns_scanned)
+            .key("stop_events").number(round.stop_events)
+            .key("labels_merged").number(round.labels_merged).key("labels_dominated").number(round.labels_dominated)
+            .endObject();
+    }
+    json.endArray().endObject();
+}
+
+// Runs one query and writes its result object. Returns the number of journeys found, or -1 if
+// a stop is unknown. A search stopped by its time budget or by `cancelled` is answered with
+// what it found so far and "partial": true.
+int writeRoute(JsonWriter& json, const RouteQuery& query, const Timetable& timetable, const ServerConfig& config,
+               const std::function<bool()>& cancelled = nullptr) {
+    if (!timetable.stops.count(query.from) || !timetable.stops.count(query.to)) {
+        json.beginObject().key("error").string("Unknown stop id").endObject();
+        return -1;
+    }
 
-// --- NEW: Path Reconstruction Function ---
-std::vector<PathStep> reconstructPath(int start_id, int end_id, const Journey& final_journey,
-                                      const std::map<int, std::map<int, Journey>>& predecessors,
-                                      const std::map<int, Stop>& stops) {
-    std::vector<PathStep> path;
-    Journey current_journey = final_journey;
-    int current_stop = end_id;
+    // Execute the RAPTOR algorithm
+    std::map<int, std::vector<Journey>> final_profiles;
 
-    while (current_stop != start_id && current_journey.from_stop_id != -1) {
-        path.push_back({current_stop, getStopName(current_stop, stops), current_journey.arrival_time, current_journey.method});
-        int prev_stop = current_journey.from_stop_id;
-        int prev_trips = current_journey.method == "Walk" ? current_journey.trips : current_journey.trips - 1;
+    // Every label of the search, kept for path reconstruction. Each worker reuses its arrays, as
+    // the engine does its scratch.
+    static thread_local RoundLabels labels;
+    RaptorStats stats;
+    RaptorExplain explain;
+    if (query.explain) stats.explain = &explain;
+    RaptorLimits limits = queryLimits(config, query.rounds, query.walk_meters, query.budget_ms);
+    limits.cancelled = cancelled;
+    runMultiCriteriaRaptor(query.from, query.to, query.time, timetable, final_profiles, labels, query.horizon_seconds, query.criteria, &stats, limits);
+    countMetric(COUNTER_ENGINE_QUERIES);
+    countMetric(COUNTER_ENGINE_ROUNDS, stats.rounds);
+    countMetric(COUNTER_PATTERNS_SCANNED, stats.patterns_scanned);
+    countMetric(COUNTER_LABELS_CREATED, stats.labels_created);
+    if (stats.partial) {
+        countMetric(COUNTER_PARTIAL_RESULTS);
+        // Searches that hit their budget are the slow pairs worth looking at
+        LogLine(LOG_WARN, "search_stopped").field("reason", cancelled && cancelled() ? "cancelled" : "deadline")
+            .field("from", query.from).field("to", query.to).field("time", query.time).field("rounds", stats.rounds);
+    }
+
+    json.beginObject().key("from").string(getStopName(query.from, timetable)).key("to").string(getStopName(query.to, timetable));
+    json.key("results").beginArray();
+    auto reconstruction_start = std::chrono::steady_clock::now();
+    int journeys = 0;
+    if (final_profiles.count(query.to)) {
+        for (const auto& journey : final_profiles.at(query.to)) {
+            ++journeys;
+            // For each journey, reconstruct its legs
+            std::vector<JourneyLeg> legs = reconstructLegs(journey, labels, timetable, query.with_stops);
+            // The search only prices fares when they are a criterion; the legs always have theirs
+            int fare = 0;
+            for (const auto& leg : legs) fare += leg.fare;
 
-        if (predecessors.count(prev_stop) && predecessors.at(prev_stop).count(prev_trips)) {
-            current_journey = predecessors.at(prev_stop).at(prev_trips);
-            current_stop = prev_stop;
-        } else {
-            break; // Path reconstruction finished or error
+            json.beginObject()
+                .key("departure_time").time(journey.departure_time).key("arrival_time").time(journey.arrival_time)
+                .key("trips").number(journey.trips).key("walk_meters").number(journey.walk_meters).key("fare").number(fare);
+            json.key("legs").beginArray();
+            for (const auto& leg : legs) writeLeg(json, leg, timetable);
+            json.endArray().endObject();
         }
     }
-    std::reverse(path.begin(), path.end());
-    return path;
+    json.endArray();
+    if (stats.partial) json.key("partial").boolean(true);
+    if (query.explain) {
+        // Includes writing the results, which is interleaved with rebuilding their legs
+        explain.reconstruction_micros = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - reconstruction_start).count();
+        writeExplain(json, stats, explain);
+    }
+    json.endObject();
+    return journeys;
 }
 
-int main() {
-    // --- 1. Load and Pre-process GTFS Data (Happens once at startup) ---
-    std::map<int, Stop> stops;
-    std::vector<StopTime> stop_times;
-    std::map<int, std::vector<Transfer>> transfers_map;
-    std::map<std::string, std::vector<StopTime>> trips_map;
-    std::map<int, std::vector<std::string>> routes_serving_stop;
+// Memory used by each timetable structure, as logged at startup and served by /admin/memory
+void writeMemoryReport(JsonWriter& json, const Timetable& timetable) {
+    std::vector<MemoryUsage> report = memoryReport(timetable);
+    json.beginObject().key("version").number(timetable.version)
+        .key("resident_bytes").number(static_cast<int64_t>(residentBytes(report)));
+    json.key("structures").beginArray();
+    for (const auto& usage : report) {
+        json.beginObject()
+            .key("name").string(usage.structure).key("resident").boolean(usage.resident)
+            .key("elements").number(static_cast<int64_t>(usage.elements)).key("bytes").number(static_cast<int64_t>(usage.bytes))
+            .key("bytes_per_element").number(usage.elements ? static_cast<double>(usage.bytes) / usage.elements : 0.0)
+            .endObject();
+    }
+    json.endArray().endObject();
+}
 
-    // [Omitted repetitive file loading code for brevity - keep your existing loaders]
-    std::ifstream stops_file("stops.txt"); std::string line; getline(stops_file, line);
-    //while (getline(stops_file, line)) { std::stringstream ss(line); std::string field; Stop s; getline(ss, field, ','); s.id = std::stoi(field); getline(ss, field, ','); s.name = field; stops[s.id] = s; }
-    while (getline(stops_file, line)) {
-        std::stringstream ss(line);
-        std::string stop_id_str, stop_code, stop_name, stop_lat_str, stop_lon_str;
-        Stop s;
-        // Read the first 5 columns, ignoring the rest
-        getline(ss, stop_id_str, ',');
-        getline(ss, stop_code, ',');
-        getline(ss, stop_name, ',');
-        getline(ss, stop_lat_str, ',');
-        getline(ss, stop_lon_str, ',');
+uint64_t elapsedMicros(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - since).count();
+}
 
+// Wraps a handler so that its latency and status are recorded under `endpoint`
+httplib::Server::Handler timed(MetricEndpoint endpoint, httplib::Server::Handler handler) {
+    return [endpoint, handler](const httplib::Request& req, httplib::Response& res) {
+        auto started = std::chrono::steady_clock::now();
         try {
-            s.id = std::stoi(stop_id_str);
-            s.name = stop_name;
-            s.lat = std::stod(stop_lat_str);
-            s.lon = std::stod(stop_lon_str);
-            stops[s.id] = s;
+            handler(req, res);
+        } catch (...) {
+            recordRequest(endpoint, 500, elapsedMicros(started));
+            throw;
+        }
+        recordRequest(endpoint, res.status, elapsedMicros(started));
+    };
+}
+
+// Parses a /api/route/batch body: an array of objects with "from", "to", "time" and optionally
+// "horizon" (hours), "criteria", "stops", "explain", "rounds", "walk" and "budget_ms", named like
+// the /api/route parameters
+bool parseBatch(const std::string& body, std::vector<RouteQuery>& queries, std::string& error, const ServerConfig& config) {
+    JsonReader reader(body);
+    if (!reader.consume('[')) {
+        error = "Expected a JSON array of queries";
+        return false;
+    }
+    if (reader.consume(']')) return reader.atEnd();
+    do {
+        if (queries.size() == static_cast<size_t>(config.max_batch_queries)) {
+            error = "Too many queries in one batch";
+            return false;
+        }
+        RouteQuery query;
+        bool has_from = false, has_to = false, has_time = false;
+        if (!reader.consume('{')) {
+            error = "Each query must be a JSON object";
+            return false;
+        }
+        if (!reader.consume('}')) {
+            do {
+                std::string key, text, unknown;
+                double number;
+                int hours;
+                // Numbers are checked like the /api/route parameters of the same names
+                auto whole = [&](const char* name, int min, int& value) {
+                    if (!(number >= min && number <= INT_MAX && number == std::floor(number))) {
+                        error = intRangeError(name, min, INT_MAX);
+                        return false;
+                    }
+                    value = static_cast<int>(number);
+                    return true;
+                };
+                auto nonNegative = [&](const char* name, double& value) {
+                    if (!std::isfinite(number) || number < 0) {
+                        error = numberError(name);
+                        return false;
+                    }
+                    value = number;
+                    return true;
+                };
+                if (!reader.readString(key) || !reader.consume(':')) break;
+                if (key == "from" && reader.readNumber(number)) { if (!whole("from", 0, query.from)) return false; has_from = true; }
+                else if (key == "to" && reader.readNumber(number)) { if (!whole("to", 0, query.to)) return false; has_to = true; }
+                else if (key == "time" && reader.readString(text)) { query.time = Time(text); has_time = true; }
+                else if (key == "horizon" && reader.readNumber(number)) { if (!whole("horizon", 1, hours)) return false; query.horizon_seconds = horizonSeconds(hours, config); }
+                else if (key == "stops" && reader.readNumber(number)) query.with_stops = number == 1;
+                else if (key == "explain" && reader.readNumber(number)) query.explain = number == 1;
+                else if (key == "rounds" && reader.readNumber(number)) { if (!whole("rounds", 1, query.rounds)) return false; }
+                else if (key == "walk" && reader.readNumber(number)) { if (!nonNegative("walk", query.walk_meters)) return false; }
+                else if (key == "budget_ms" && reader.readNumber(number)) { if (!whole("budget_ms", 1, query.budget_ms)) return false; }
+                else if (key == "criteria" && reader.readString(text)) {
+                    if (!parseCriteria(text, query.criteria, unknown)) {
+                        error = "Unknown criterion: " + unknown;
+                        return false;
+                    }
+                }
+                else if (!reader.skipValue()) {
+                    error = "Malformed batch body";
+                    return false;
+                }
+            } while (reader.consume(','));
+            if (!reader.consume('}')) {
+                error = "Malformed query object";
+                return false;
+            }
+        }
+        if (!has_from || !has_to || !has_time) {
+            error = "Each query needs from, to and time";
+            return false;
+        }
+        queries.push_back(query);
+    } while (reader.consume(','));
+    if (!reader.consume(']') || !reader.atEnd()) {
+        error = "Malformed batch body";
+        return false;
+    }
+    return true;
+}
+
+// One batch request. Queries are taken in any order and their results written back in request
+// order, each as soon as it and every earlier one is done.
+struct BatchJob {
+    std::shared_ptr<const Timetable> timetable;
+    const ServerConfig* config;
+    std::vector<RouteQuery> queries;
+    std::chrono::steady_clock::time_point started;
+    std::atomic<size_t> next_query{0};
+    std::mutex mutex;
+    std::vector<std::string> results; // serialized result of each query, once done
+    std::vector<char> done;
+    size_t written = 0;               // results passed on to the response so far
+    bool complete = false;            // the closing "]" has been passed on
+
+    // Recorded once the last reference is gone: the response is complete or abandoned
+    ~BatchJob() {
+        if (timetable) recordRequest(ENDPOINT_ROUTE_BATCH, 200, elapsedMicros(started));
+    }
+
+    // Runs one query nobody has taken yet. Returns false if none was left.
+    bool runNext(const std::function<bool()>& cancelled) {
+        size_t i = next_query++;
+        if (i >= queries.size()) return false;
+        std::string result;
+        JsonWriter json(result);
+        try {
+            writeRoute(json, queries[i], *timetable, *config, cancelled);
         } catch (const std::exception& e) {
-            // This safely skips any lines with bad data
+            result.clear();
+            JsonWriter(result).beginObject().key("error").string(e.what()).endObject();
         }
+        std::lock_guard<std::mutex> lock(mutex);
+        results[i].swap(result);
+        done[i] = 1;
+        return true;
     }
-    std::ifstream st_file("stop_times.txt"); getline(st_file, line);
-    while (getline(st_file, line)) { std::stringstream ss(line); std::string field; StopTime st; getline(ss, field, ','); st.trip_id = field; getline(ss, field, ','); st.arrival_time = Time(field); getline(ss, field, ','); st.departure_time = Time(field); getline(ss, field, ','); st.stop_id = std::stoi(field); getline(ss, field, ','); st.stop_sequence = std::stoi(field); stop_times.push_back(st); }
-    std::ifstream tr_file("transfers.txt"); getline(tr_file, line);
-    while (getline(tr_file, line)) { std::stringstream ss(line); std::string field; Transfer t; getline(ss, field, ','); t.from_stop_id = std::stoi(field); getline(ss, field, ','); t.to_stop_id = std::stoi(field); getline(ss, field, ','); t.duration_seconds = std::stoi(field); transfers_map[t.from_stop_id].push_back(t); }
 
-    for (const auto& st : stop_times) {
-        trips_map[st.trip_id].push_back(st);
-        routes_serving_stop[st.stop_id].push_back(st.trip_id);
+    // Passes the results that are next in request order to `write`, as pieces of one JSON array.
+    // The lock is held throughout, so concurrent callers keep the order. Returns true on the one
+    // call that completes the array.
+    bool writeReady(const std::function<void(const std::string&)>& write) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (complete) return false;
+        std::string pieces;
+        for (; written < queries.size() && done[written]; ++written) {
+            pieces += written == 0 ? "[" : ",";
+            pieces += results[written];
+            std::string().swap(results[written]);
+        }
+        if (written == queries.size()) {
+            pieces += queries.empty() ? "[]" : "]";
+            complete = true;
+        }
+        write(pieces);
+        return complete;
     }
-    for (auto& pair : trips_map) { std::sort(pair.second.begin(), pair.second.end(), [](const StopTime& a, const StopTime& b) { return a.stop_sequence < b.stop_sequence; }); }
-    for (auto& pair : routes_serving_stop) { std::sort(pair.second.begin(), pair.second.end()); pair.second.erase(std::unique(pair.second.begin(), pair.second.end()), pair.second.end()); }
-    std::cout << "Data loaded and pre-processed for server." << std::endl;
+};
+
+#ifdef __linux__
+// Runs one query of `job` on a worker, streams whatever became ready and queues itself again,
+// behind the requests that arrived meanwhile: a batch holds at most as many workers as it was
+// started with, and never one that waits
+void runBatchStep(EpollServer& svr, const std::shared_ptr<BatchJob>& job, const std::shared_ptr<ResponseStream>& stream) {
+    if (stream->closed() || !job->runNext([&stream] { return stream->closed(); })) return;
+    if (job->writeReady([&stream](const std::string& pieces) { stream->write(pieces); })) stream->finish();
+    svr.submit([&svr, job, stream] { runBatchStep(svr, job, stream); });
+}
+#endif
+
+int main(int argc, char* argv[]) {
+    // --- 0. Settings: defaults, then the config file, then the command line ---
+    ServerConfig config;
+    try {
+        if (!parseCommandLine(argc, argv, config)) {
+            std::cout << configUsage(argv[0]);
+            return 0;
+        }
+        validateConfig(config);
+    } catch (const std::exception& e) {
+        LogLine(LOG_ERROR, "config_failed").field("error", e.what());
+        std::cerr << configUsage(argv[0]);
+        return 2;
+    }
+    const unsigned hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    const int workers = config.workers > 0 ? config.workers : static_cast<int>(hardware_threads);
+
+    // --- 1. Load and Pre-process GTFS Data (Happens once at startup, then on /admin/reload) ---
+    TimetableStore timetable_store(config.data_dir);
+    startLogging(config.log_level, config.log_sample_every);
+    LogLine(LOG_INFO, "config").field("data_dir", config.data_dir).field("workers", workers)
+        .field("rounds", config.rounds).field("max_rounds", config.max_rounds)
+        .field("walk_meters", static_cast<int64_t>(config.walk_meters)).field("max_walk_meters", static_cast<int64_t>(config.max_walk_meters))
+        .field("time_budget_ms", config.time_budget_ms);
+    try {
+        timetable_store.publish(loadTimetable(timetable_store.dataDir(), 1));
+    } catch (const std::exception& e) {
+        LogLine(LOG_ERROR, "load_failed").field("error", e.what());
+        stopLogging();
+        return 1;
+    }
+    LogLine(LOG_INFO, "data_loaded").field("kernels", simdLevelName());
+    std::vector<MemoryUsage> memory = memoryReport(*timetable_store.current());
+    for (const auto& usage : memory) {
+        LogLine(LOG_INFO, "memory").field("structure", usage.structure).field("resident", usage.resident ? "yes" : "freed")
+            .field("elements", static_cast<uint64_t>(usage.elements)).field("bytes", static_cast<uint64_t>(usage.bytes))
+            .field("bytes_per_element", static_cast<uint64_t>(usage.elements ? usage.bytes / usage.elements : 0));
+    }
+    LogLine(LOG_INFO, "memory_total").field("resident_bytes", static_cast<uint64_t>(residentBytes(memory)));
 
     // --- 2. Create and Configure the Web Server ---
+    // On Linux, an epoll event loop per listener instead of httplib's thread per connection;
+    // both take the same handlers
+#ifdef __linux__
+    EpollServer svr;
+#else
     httplib::Server svr;
+#endif
 
-    // This tells the server to serve files from the same directory the .exe is in
-    svr.set_base_dir("./");
+    // The web UI; by default the directory the server is started in
+    if (!svr.set_base_dir(config.web_dir)) LogLine(LOG_WARN, "web_dir_missing").field("web_dir", config.web_dir);
 
 
 
     // API Endpoint to get the list of all stops
-    svr.Get("/api/stops", [&](const httplib::Request& req, httplib::Response& res) {
-        std::stringstream json;
-        json << "[";
-        for (auto it = stops.begin(); it != stops.end(); ++it) {
+    svr.Get("/api/stops", timed(ENDPOINT_STOPS, [&](const httplib::Request& req, httplib::Response& res) {
+        auto timetable = timetable_store.current();
+        std::string body;
+        JsonWriter json(body);
+        json.beginArray();
+        for (const auto& pair : timetable->stops) {
+            json.beginObject().key("id").number(pair.first).key("name");
+            writePooled(json, timetable->strings, pair.second.name);
             // Add lat and lon to the JSON response
-            json << "{\"id\":" << it->first
-                << ",\"name\":\"" << it->second.name
-                << "\",\"lat\":" << it->second.lat
-                << ",\"lon\":" << it->second.lon
-                << "}";
-            if (std::next(it) != stops.end()) json << ",";
-
+            json.key("lat").number(pair.second.lat).key("lon").number(pair.second.lon).endObject();
         }
-        json << "]";
-        res.set_content(json.str(), "application/json");
-    });
+        json.endArray();
+        res.set_content(std::move(body), "application/json");
+    }));
 
     // API Endpoint to calculate a route
-    svr.Get("/api/route", [&](const httplib::Request& req, httplib::Response& res) {
+    svr.Get("/api/route", timed(ENDPOINT_ROUTE, [&](const httplib::Request& req, httplib::Response& res) {
+        auto started = std::chrono::steady_clock::now();
         // Check for required parameters
         if (!req.has_param("from") || !req.has_param("to") || !req.has_param("time")) {
-            res.status = 400;
-            res.set_content("{\"error\":\"Missing required parameters: from, to, time\"}", "application/json");
+            sendError(res, 400, "Missing required parameters: from, to, time");
             return;
         }
 
+        // Pin the current timetable for the whole request; a concurrent reload won't affect it
+        auto timetable = timetable_store.current();
+
         // Parse parameters from the URL
-        int start_node = std::stoi(req.get_param_value("from"));
-        int end_node = std::stoi(req.get_param_value("to"));
+        RouteQuery query;
+        int horizon_hours = -1;
+        if (!intParam(req, res, "from", 0, INT_MAX, query.from) || !intParam(req, res, "to", 0, INT_MAX, query.to) ||
+            !intParam(req, res, "horizon", 1, INT_MAX, horizon_hours)) return;
         std::string time_str = req.get_param_value("time");
-        // --- ADD THESE DEBUGGING LINES ---
-        std::cout << "--------------------------------" << std::endl;
-        std::cout << "New Route Request:" << std::endl;
-        std::cout << "FROM: " << start_node << " (" << getStopName(start_node, stops) << ")" << std::endl;
-        std::cout << "TO:   " << end_node << " (" << getStopName(end_node, stops) << ")" << std::endl;
-        std::cout << "TIME: " << time_str << std::endl;
-        std::cout << "--------------------------------" << std::endl;
-
-        // Execute the RAPTOR algorithm
-        std::map<int, std::vector<Journey>> final_profiles;
-
-        // *** FIX 1: DECLARE the predecessors map here ***
-        std::map<int, std::map<int, Journey>> predecessors;
-
-        // *** FIX 2: PASS the predecessors map to the function ***
-        runMultiCriteriaRaptor(start_node, end_node, Time(time_str), stops, transfers_map, trips_map, routes_serving_stop, final_profiles, predecessors);
-
-        // Format the result as a JSON string
-        std::stringstream json;
-        json << "{\"from\":\"" << getStopName(start_node, stops) << "\",\"to\":\"" << getStopName(end_node, stops) << "\",\"results\":[";
-
-        if (final_profiles.count(end_node)) {
-            const auto& results = final_profiles.at(end_node);
-            for (auto it = results.begin(); it != results.end(); ++it) {
-                // For each journey, reconstruct its path
-                std::vector<PathStep> path = reconstructPath(start_node, end_node, *it, predecessors, stops);
-
-                // *** THIS IS THE LINE TO CHANGE ***
-                json << "{\"departure_time\":\"" << it->departure_time << "\",\"arrival_time\":\"" << it->arrival_time << "\",\"trips\":" << it->trips << ",\"path\":[";
-
-                // Add path steps to JSON
-                for (auto p_it = path.begin(); p_it != path.end(); ++p_it) {
-                    json << "{\"stop_id\":" << p_it->stop_id << ", \"stop_name\":\"" << p_it->stop_name << "\", \"arrival_time\":\"" << p_it->arrival_time << "\", \"method\":\"" << p_it->method << "\"}";
-                    if (std::next(p_it) != path.end()) json << ",";
-                }
-                json << "]}";
-                if (std::next(it) != results.end()) json << ",";
-            }
+        query.time = Time(time_str);
+        if (horizon_hours > 0) query.horizon_seconds = horizonSeconds(horizon_hours, config);
+        // Engine limits, clamped to the server's: ?rounds=, ?walk= (meters) and ?budget_ms=
+        if (!intParam(req, res, "rounds", 1, INT_MAX, query.rounds) || !numberParam(req, res, "walk", query.walk_meters) ||
+            !intParam(req, res, "budget_ms", 1, INT_MAX, query.budget_ms)) return;
+        // Optional extra Pareto criteria, e.g. ?criteria=walking,fare
+        std::string unknown;
+        if (req.has_param("criteria") && !parseCriteria(req.get_param_value("criteria"), query.criteria, unknown)) {
+            sendError(res, 400, "Unknown criterion: " + unknown);
+            return;
         }
+        // Intermediate stops of each trip leg are only listed with ?stops=1
+        query.with_stops = req.has_param("stops") && req.get_param_value("stops") == "1";
+        // Per-round engine counters and phase times are added with ?explain=1
+        query.explain = req.has_param("explain") && req.get_param_value("explain") == "1";
 
-        json << "]}";
+        // Format the result as JSON, straight into the response body
+        std::string body;
+        JsonWriter json(body);
+        // A client that hangs up stops the search; whatever was found is still sent
+        int journeys = writeRoute(json, query, *timetable, config, req.is_connection_closed);
 
-        // Send the JSON back as the response
-        res.set_content(json.str(), "application/json");
+        // One line per request, sampled; failed lookups are always logged
+        if (journeys < 0 || logSampled()) {
+            LogLine(journeys < 0 ? LOG_WARN : LOG_INFO, "route")
+                .field("request_id", nextRequestId())
+                .field("from", query.from).field("from_name", getStopName(query.from, *timetable))
+                .field("to", query.to).field("to_name", getStopName(query.to, *timetable))
+                .field("time", query.time).field("journeys", journeys)
+                .field("latency_us", elapsedMicros(started));
+        }
+
+        // Send the JSON back as the response; for an unknown stop it holds the error
+        if (journeys < 0) res.status = 400;
+        res.set_content(std::move(body), "application/json");
+    }));
+
+    // Batch endpoint for machine clients: a JSON array of route queries, answered in parallel and
+    // streamed back as a JSON array of results in the same order
+    // Its latency is recorded when the last result has been streamed, not when the handler returns.
+    auto newBatchJob = [&](const httplib::Request& req, httplib::Response& res) {
+        auto job = std::make_shared<BatchJob>();
+        job->started = std::chrono::steady_clock::now();
+        std::string error;
+        if (!parseBatch(req.body, job->queries, error, config)) {
+            sendError(res, 400, error);
+            recordRequest(ENDPOINT_ROUTE_BATCH, 400, elapsedMicros(job->started));
+            return std::shared_ptr<BatchJob>();
+        }
+        // Every query of the batch runs on the same timetable snapshot
+        job->timetable = timetable_store.current();
+        job->config = &config;
+        job->results.resize(job->queries.size());
+        job->done.assign(job->queries.size(), 0);
+        return job;
+    };
+#ifdef __linux__
+    // The queries run on the server's workers, `batch_threads` of them at a time, and the
+    // results are streamed as they become ready; no thread waits for them
+    svr.PostStreaming("/api/route/batch", [&](const httplib::Request& req, httplib::Response& res, const StreamOpener& open) {
+        auto job = newBatchJob(req, res);
+        if (!job) return;
+        auto stream = open("application/json");
+        if (job->writeReady([&stream](const std::string& pieces) { stream->write(pieces); })) {
+            stream->finish(); // an empty batch
+            return;
+        }
+        size_t steps = std::min<size_t>(config.batch_threads > 0 ? config.batch_threads : workers, job->queries.size());
+        for (size_t i = 0; i < steps; ++i) svr.submit([&svr, job, stream] { runBatchStep(svr, job, stream); });
     });
+#else
+    // httplib gives the request a thread of its own; the queries run on it, one per chunk
+    svr.Post("/api/route/batch", [&](const httplib::Request& req, httplib::Response& res) {
+        auto job = newBatchJob(req, res);
+        if (!job) return;
+        res.set_chunked_content_provider("application/json", [job](size_t, httplib::DataSink& sink) {
+            job->runNext([&sink] { return !sink.is_writable(); });
+            bool complete = job->writeReady([&sink](const std::string& pieces) { sink.write(pieces.data(), pieces.size()); });
+            if (complete) sink.done();
+            return sink.is_writable();
+        });
+    });
+#endif
+
+    // API Endpoint for range queries: `count` departures from `time`, every `interval` minutes,
+    // evaluated together in one profile search
+    svr.Get("/api/profile", timed(ENDPOINT_PROFILE, [&](const httplib::Request& req, httplib::Response& res) {
+        if (!req.has_param("from") || !req.has_param("to") || !req.has_param("time")) {
+            sendError(res, 400, "Missing required parameters: from, to, time");
+            return;
+        }
+        auto timetable = timetable_store.current();
+        int start_node = 0, end_node = 0, count = 16, interval_minutes = 5, rounds = -1, budget_ms = -1;
+        double walk_meters = -1;
+        // More departures than one profile pass evaluates are cut to MAX_PROFILE_DEPARTURES
+        if (!intParam(req, res, "from", 0, INT_MAX, start_node) || !intParam(req, res, "to", 0, INT_MAX, end_node) ||
+            !intParam(req, res, "count", 1, INT_MAX, count) || !intParam(req, res, "interval", 1, 24 * 60, interval_minutes) ||
+            !intParam(req, res, "rounds", 1, INT_MAX, rounds) || !numberParam(req, res, "walk", walk_meters) ||
+            !intParam(req, res, "budget_ms", 1, INT_MAX, budget_ms)) return;
+        if (!timetable->stops.count(start_node) || !timetable->stops.count(end_node)) {
+            sendError(res, 400, "Unknown stop id");
+            return;
+        }
+        int first_departure = Time(req.get_param_value("time")).toSeconds();
+        count = std::min(count, MAX_PROFILE_DEPARTURES);
+
+        std::vector<Time> departure_times;
+        for (int i = 0; i < count; ++i) departure_times.push_back(Time::fromSeconds(first_departure + i * interval_minutes * 60));
+        RaptorLimits limits = queryLimits(config, rounds, walk_meters, budget_ms);
+        limits.cancelled = req.is_connection_closed;
+        std::vector<ProfileJourney> results;
+        bool complete = runProfileRaptor(start_node, end_node, departure_times, *timetable, results, DEFAULT_HORIZON_SECONDS, limits);
+        if (!complete) countMetric(COUNTER_PARTIAL_RESULTS);
+
+        std::string body;
+        JsonWriter json(body);
+        json.beginObject().key("from").string(getStopName(start_node, *timetable)).key("to").string(getStopName(end_node, *timetable));
+        json.key("results").beginArray();
+        for (const auto& result : results) {
+            json.beginObject().key("departure_time").time(result.departure_time).key("arrival_time").time(result.arrival_time)
+                .key("trips").number(result.trips).endObject();
+        }
+        json.endArray();
+        if (!complete) json.key("partial").boolean(true);
+        json.endObject();
+        res.set_content(std::move(body), "application/json");
+    }));
+
+    // Prometheus scrape endpoint
+    svr.Get("/metrics", timed(ENDPOINT_METRICS, [&](const httplib::Request& req, httplib::Response& res) {
+        res.set_content(renderMetrics(), "text/plain; version=0.0.4");
+    }));
+
+    // Admin endpoint: rebuild the timetable from disk in the background and swap it in
+    svr.Post("/admin/reload", timed(ENDPOINT_ADMIN_RELOAD, [&](const httplib::Request& req, httplib::Response& res) {
+        if (!timetable_store.reloadAsync()) {
+            sendError(res, 409, "A reload is already in progress");
+            return;
+        }
+        res.status = 202;
+        res.set_content("{\"status\":\"reloading\"}", "application/json");
+    }));
+
+    // Admin endpoint: estimated bytes per timetable structure and per element
+    svr.Get("/admin/memory", timed(ENDPOINT_ADMIN_MEMORY, [&](const httplib::Request& req, httplib::Response& res) {
+        std::string body;
+        JsonWriter json(body);
+        writeMemoryReport(json, *timetable_store.current());
+        res.set_content(std::move(body), "application/json");
+    }));
+
+    svr.Get("/admin/status", timed(ENDPOINT_ADMIN_STATUS, [&](const httplib::Request& req, httplib::Response& res) {
+        auto timetable = timetable_store.current();
+        std::string body;
+        JsonWriter(body).beginObject()
+            .key("version").number(timetable->version)
+            .key("stops").number(static_cast<int64_t>(timetable->stops.size()))
+            .key("trips").number(static_cast<int64_t>(timetable->trip_count))
+            .key("patterns").number(static_cast<int64_t>(timetable->patterns.size()))
+            .key("reloading").boolean(timetable_store.reloading())
+            .key("last_error").string(timetable_store.lastError())
+            .endObject();
+        res.set_content(std::move(body), "application/json");
+    }));
 
     // --- 3. Start the Server ---
-    std::cout << "Server starting on http://localhost:8080" << std::endl;
-    svr.listen("localhost", 8080);
+    std::string url = "http://" + config.host + ":" + std::to_string(config.port);
+#ifdef __linux__
+    ListenerOptions listener;
+    listener.host = config.host;
+    listener.port = config.port;
+    listener.listeners = config.listeners > 0 ? config.listeners : static_cast<int>(std::min(4u, hardware_threads));
+    listener.workers = workers;
+    listener.backlog = config.backlog;
+    listener.keep_alive_seconds = config.keep_alive_seconds;
+    listener.max_body_bytes = config.max_batch_bytes;
+    LogLine(LOG_INFO, "listening").field("url", url).field("listeners", listener.listeners)
+        .field("backlog", listener.backlog);
+    bool served = svr.listen(listener);
+#else
+    svr.new_task_queue = [workers] { return new httplib::ThreadPool(workers); };
+    svr.set_keep_alive_timeout(config.keep_alive_seconds);
+    svr.set_payload_max_length(config.max_batch_bytes);
+    LogLine(LOG_INFO, "listening").field("url", url);
+    bool served = svr.listen(config.host, config.port);
+#endif
+    stopLogging();
 
-    return 0;
+    return served ? 0 : 1;
 }
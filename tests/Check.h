@@ -0,0 +1,28 @@
+#ifndef CHECK_H_INCLUDED
+#define CHECK_H_INCLUDED
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+// Minimal assertions for the ctest executables. A failed CHECK prints its location and keeps
+// going; main() returns checkFailures(), so ctest sees every failure of a run at once.
+inline int& checkFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                      \
+    do {                                                                                      \
+        if (!(condition)) {                                                                   \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++checkFailures();                                                                \
+        }                                                                                     \
+    } while (0)
+
+// Writes one file of a small test feed into `dir`, which exists
+inline void writeFile(const std::string& dir, const char* name, const char* contents) {
+    std::ofstream(dir + "/" + name, std::ios::binary) << contents;
+}
+
+#endif // CHECK_H_INCLUDED
@@ -0,0 +1,143 @@
+// Server settings: the config file format, the command line on top of it, the checks at startup
+// and the clamping of what a single request asks for. Usage: ConfigTest <empty directory>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Config.h"
+#include "SimdKernels.h"
+#include "Check.h"
+
+// The message parseCommandLine, loadConfigFile or validateConfig fails with, or "" if none
+template <typename F>
+static std::string failure(F f) {
+    try {
+        f();
+    } catch (const std::runtime_error& e) {
+        return e.what();
+    }
+    return "";
+}
+
+static bool parse(std::vector<std::string> args, ServerConfig& config) {
+    args.insert(args.begin(), "TemporalPathfinder");
+    std::vector<char*> argv;
+    for (std::string& arg : args) argv.push_back(&arg[0]);
+    return parseCommandLine(static_cast<int>(argv.size()), argv.data(), config);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::fprintf(stderr, "usage: %s <directory>\n", argv[0]);
+        return 2;
+    }
+    const std::string dir = argv[1];
+
+    // Comments, blank lines and whitespace around keys and values
+    writeFile(dir, "server.conf",
+              "# listener\n"
+              "\n"
+              "  port = 9090   # trailing comment\n"
+              "host=0.0.0.0\n"
+              "\tmax_walk_meters = 2500.5\n"
+              "log_level = warn\n");
+    {
+        ServerConfig config;
+        loadConfigFile(dir + "/server.conf", config);
+        CHECK(config.port == 9090 && config.host == "0.0.0.0");
+        CHECK(config.max_walk_meters == 2500.5 && config.log_level == LOG_WARN);
+        CHECK(config.rounds == ServerConfig().rounds);
+    }
+
+    // Bad files name the file and line
+    writeFile(dir, "unknown.conf", "port = 9090\nspeed = 3\n");
+    writeFile(dir, "negative.conf", "# rounds\nrounds = -2\n");
+    writeFile(dir, "no_equals.conf", "port 9090\n");
+    writeFile(dir, "level.conf", "log_level = verbose\n");
+    ServerConfig scratch;
+    CHECK(failure([&] { loadConfigFile(dir + "/unknown.conf", scratch); }) == dir + "/unknown.conf:2: unknown setting speed");
+    CHECK(failure([&] { loadConfigFile(dir + "/negative.conf", scratch); }).find("negative.conf:2: rounds: ") != std::string::npos);
+    CHECK(failure([&] { loadConfigFile(dir + "/no_equals.conf", scratch); }).find("no_equals.conf:1: expected key = value") != std::string::npos);
+    CHECK(failure([&] { loadConfigFile(dir + "/level.conf", scratch); }).find("level.conf:1: log_level: ") != std::string::npos);
+    CHECK(!failure([&] { loadConfigFile(dir + "/missing.conf", scratch); }).empty());
+
+    // The command line wins over the file wherever --config appears, in either option form
+    {
+        ServerConfig config;
+        CHECK(parse({"--port=7070", "--config", dir + "/server.conf", "--walk_meters", "800"}, config));
+        CHECK(config.port == 7070 && config.host == "0.0.0.0" && config.walk_meters == 800);
+        CHECK(config.max_walk_meters == 2500.5);
+    }
+    {
+        ServerConfig config;
+        CHECK(parse({"--config=" + dir + "/server.conf", "--log_level", "debug"}, config));
+        CHECK(config.port == 9090 && config.log_level == LOG_DEBUG);
+    }
+    {
+        ServerConfig config;
+        CHECK(!parse({"--port", "1", "--help"}, config));
+        CHECK(!parse({"-h"}, config));
+    }
+    CHECK(failure([&] { parse({"--port"}, scratch); }) == "Missing value for --port");
+    CHECK(failure([&] { parse({"--prot=1"}, scratch); }) == "Unknown option --prot=1");
+    CHECK(failure([&] { parse({"port=1"}, scratch); }) == "Unexpected argument port=1");
+    CHECK(failure([&] { parse({"--workers=many"}, scratch); }).find("--workers: ") == 0);
+    CHECK(!failure([&] { parse({"--config", dir + "/unknown.conf"}, scratch); }).empty());
+
+    // Startup checks: the defaults pass, and every default stays within its cap
+    CHECK(failure([] { validateConfig(ServerConfig()); }).empty());
+    auto invalid = [](void (*change)(ServerConfig&)) {
+        ServerConfig config;
+        change(config);
+        return !failure([&] { validateConfig(config); }).empty();
+    };
+    CHECK(invalid([](ServerConfig& c) { c.port = 0; }));
+    CHECK(invalid([](ServerConfig& c) { c.port = 65536; }));
+    CHECK(invalid([](ServerConfig& c) { c.backlog = 0; }));
+    CHECK(invalid([](ServerConfig& c) { c.rounds = 0; }));
+    CHECK(invalid([](ServerConfig& c) { c.max_rounds = 65; c.rounds = 65; }));
+    CHECK(invalid([](ServerConfig& c) { c.rounds = c.max_rounds + 1; }));
+    CHECK(invalid([](ServerConfig& c) { c.walk_meters = c.max_walk_meters + 1; }));
+    CHECK(invalid([](ServerConfig& c) { c.max_walk_meters = NEARBY_FILTER_MAX_METERS + 1; }));
+    CHECK(invalid([](ServerConfig& c) { c.walking_speed_mps = 0; }));
+    CHECK(invalid([](ServerConfig& c) { c.max_horizon_hours = 0; }));
+    CHECK(invalid([](ServerConfig& c) { c.max_batch_bytes = 1; }));
+    CHECK(!invalid([](ServerConfig& c) { c.max_rounds = 64; c.max_walk_meters = NEARBY_FILTER_MAX_METERS; }));
+
+    // Per-query limits: defaults when not given, clamped to the caps otherwise
+    ServerConfig config;
+    config.rounds = 4;
+    config.max_rounds = 6;
+    config.walk_meters = 500;
+    config.max_walk_meters = 1200;
+    config.walking_speed_mps = 1.2;
+    {
+        RaptorLimits limits = queryLimits(config);
+        CHECK(limits.max_trips == 4 && limits.max_walk_meters == 500 && limits.walking_speed_mps == 1.2);
+        CHECK(!limits.bounded());
+    }
+    CHECK(queryLimits(config, 0).max_trips == 1);
+    CHECK(queryLimits(config, 5).max_trips == 5);
+    CHECK(queryLimits(config, 1000000).max_trips == 6);
+    CHECK(queryLimits(config, -1, 0).max_walk_meters == 0);
+    CHECK(queryLimits(config, -1, 900).max_walk_meters == 900);
+    CHECK(queryLimits(config, -1, 1e9).max_walk_meters == 1200);
+
+    // A request may shorten the configured time budget but not lengthen it
+    auto budget_ms = [](const RaptorLimits& limits, std::chrono::steady_clock::time_point before) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(limits.deadline - before).count();
+    };
+    auto before = std::chrono::steady_clock::now();
+    RaptorLimits asked = queryLimits(config, -1, -1, 2000);
+    CHECK(asked.bounded() && budget_ms(asked, before) >= 2000 && budget_ms(asked, before) < 3000);
+    CHECK(!queryLimits(config, -1, -1, 0).bounded());
+    config.time_budget_ms = 1000;
+    before = std::chrono::steady_clock::now();
+    RaptorLimits capped = queryLimits(config, -1, -1, 60000);
+    CHECK(budget_ms(capped, before) >= 1000 && budget_ms(capped, before) < 2000);
+    RaptorLimits shorter = queryLimits(config, -1, -1, 100);
+    CHECK(budget_ms(shorter, before) < 1000);
+    RaptorLimits configured = queryLimits(config);
+    CHECK(configured.bounded() && budget_ms(configured, before) >= 1000 && budget_ms(configured, before) < 2000);
+    return checkFailures();
+}
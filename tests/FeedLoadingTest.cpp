@@ -0,0 +1,66 @@
+// Loading a feed whose files list their columns in an unusual order, with extra columns, and
+// rejecting one that lacks a required column. Usage: FeedLoadingTest <empty directory>
+#include <stdexcept>
+#include <string>
+#include "Timetable.h"
+#include "Check.h"
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::fprintf(stderr, "usage: %s <directory>\n", argv[0]);
+        return 2;
+    }
+    const std::string dir = argv[1]; // no trailing separator: loadTimetable adds it
+    writeFile(dir, "stops.txt",
+              "zone_id,stop_lon,stop_name,wheelchair_boarding,stop_lat,stop_id\n"
+              "Z1,4.5,\"Central, North\",1,52.25,7\n"
+              "Z2,4.6,South,0,52.5,3\r\n"
+              ",4.7,East,,52.75,11\n");
+    // Rows out of stop_sequence order, as feeds are allowed to list them
+    writeFile(dir, "stop_times.txt",
+              "stop_sequence,stop_id,pickup_type,departure_time,trip_id,arrival_time\n"
+              "2,3,0,08:10:30,T1,08:10:00\n"
+              "1,7,0,08:00:00,T1,08:00:00\n"
+              "3,11,0,08:20:00,T1,08:19:00\n"
+              "1,7,0,09:00:00,T2,09:00:00\n"
+              "3,11,0,09:20:00,T2,09:20:00\n"
+              "2,3,0,09:10:00,T2,09:10:00\n");
+    writeFile(dir, "trips.txt", "service_id,trip_headsign,route_id,trip_id\nWK,x,R9,T1\nWK,y,R9,T2\n");
+    writeFile(dir, "routes.txt", "route_long_name,route_type,route_id,route_short_name\nLong name,3,R9,9\n");
+
+    auto timetable = loadTimetable(dir, 1);
+    CHECK(timetable->stops.size() == 3);
+    const Stop& central = timetable->stops.at(7);
+    CHECK(timetable->strings.str(central.name) == "Central, North");
+    CHECK(central.lat == 52.25 && central.lon == 4.5 && central.has_location);
+    CHECK(timetable->strings.str(central.zone_id) == "Z1");
+    CHECK(timetable->strings.str(timetable->stops.at(3).name) == "South");
+    CHECK(timetable->stops.at(11).zone_id == NO_STRING);
+    CHECK(timetable->stop_id_limit == 12);
+
+    // Both trips share one pattern, in stop_sequence order, ordered by departure
+    CHECK(timetable->patterns.size() == 1 && timetable->trip_count == 2);
+    if (timetable->patterns.size() == 1) {
+        const RoutePattern& pattern = timetable->patterns[0];
+        CHECK((pattern.stops == std::vector<int>{7, 3, 11}));
+        CHECK(timetable->strings.str(pattern.trip_ids[0]) == "T1" && timetable->strings.str(pattern.trip_ids[1]) == "T2");
+        CHECK(pattern.arrival(0, 1) == Time("08:10:00").toSeconds() && pattern.departure(0, 1) == Time("08:10:30").toSeconds());
+        CHECK(pattern.arrival(0, 2) == Time("08:19:00").toSeconds());
+        CHECK(pattern.departure(1, 0) == Time("09:00:00").toSeconds());
+        CHECK(timetable->strings.str(pattern.route_id) == "R9");
+        auto route_name = timetable->route_names.find(pattern.route_id);
+        CHECK(route_name != timetable->route_names.end() && timetable->strings.str(route_name->second) == "9");
+    }
+    CHECK(timetable->patterns_serving_stop.at(3).size() == 1 && timetable->patterns_serving_stop.at(3)[0].position == 1);
+
+    // A required column missing from the header is reported with the file's name
+    writeFile(dir, "stops.txt", "stop_name,stop_lat,stop_lon\nA,1,1\n");
+    bool rejected = false;
+    try {
+        loadTimetable(dir, 2);
+    } catch (const std::runtime_error& e) {
+        rejected = std::string(e.what()).find("stops.txt") != std::string::npos;
+    }
+    CHECK(rejected);
+    return checkFailures();
+}
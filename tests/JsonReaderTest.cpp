@@ -0,0 +1,60 @@
+// JsonReader on well-formed, malformed and deeply nested input
+#include <string>
+#include "JsonReader.h"
+#include "Check.h"
+
+// True if skipValue accepts `text` as exactly one value
+static bool skipsWhole(const std::string& text) {
+    JsonReader reader(text);
+    return reader.skipValue() && reader.atEnd();
+}
+
+static std::string nested(int depth) {
+    return std::string(depth, '[') + std::string(depth, ']');
+}
+
+int main() {
+    {
+        const std::string text_in = " { \"from\" : 12.5, \"name\": \"a\\\"b\\u00e9\", \"x\": [1, {\"y\": null}] } ";
+        JsonReader reader(text_in);
+        std::string key, text;
+        double number = 0;
+        CHECK(reader.consume('{'));
+        CHECK(reader.readString(key) && key == "from");
+        CHECK(reader.consume(':') && reader.readNumber(number) && number == 12.5);
+        CHECK(reader.consume(','));
+        CHECK(reader.readString(key) && key == "name" && reader.consume(':'));
+        CHECK(reader.readString(text) && text == "a\"b\xc3\xa9");
+        CHECK(reader.consume(',') && reader.readString(key) && reader.consume(':'));
+        CHECK(reader.skipValue());
+        CHECK(reader.consume('}') && reader.atEnd());
+    }
+
+    // A failed read consumes nothing but whitespace
+    {
+        const std::string text_in = "  \"text\"";
+        JsonReader reader(text_in);
+        double number;
+        CHECK(!reader.readNumber(number));
+        CHECK(!reader.consume('{'));
+        std::string text;
+        CHECK(reader.readString(text) && text == "text");
+    }
+
+    CHECK(skipsWhole("true"));
+    CHECK(skipsWhole("-1.5e3"));
+    CHECK(skipsWhole("{\"a\": [true, false, null, \"]\"], \"b\": {}}"));
+
+    // Malformed input is refused, not skipped past
+    for (const char* text : {"", "{", "[1, 2", "{\"a\" 1}", "{\"a\": }", "\"unterminated", "[1,]", "{,}",
+                             "\"bad \\q escape\"", "\"\\u12\"", "tru", "nul", "[}", "{\"a\": 1]"}) {
+        CHECK(!skipsWhole(text));
+    }
+
+    // Nesting is accepted up to MAX_JSON_DEPTH and refused beyond, without recursing further
+    CHECK(skipsWhole(nested(MAX_JSON_DEPTH)));
+    CHECK(!skipsWhole(nested(MAX_JSON_DEPTH + 1)));
+    CHECK(!skipsWhole(std::string(1000000, '[')));
+    CHECK(!skipsWhole(std::string(500000, '{') + "\"a\":"));
+    return checkFailures();
+}
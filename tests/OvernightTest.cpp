@@ -0,0 +1,74 @@
+// Searches across midnight: trips running past 24:00:00, yesterday's trips still running after
+// midnight, and horizons reaching into the next service day. Usage: OvernightTest <empty directory>
+#include <map>
+#include <string>
+#include <vector>
+#include "Raptor.h"
+#include "Timetable.h"
+#include "Check.h"
+
+// The earliest arrival in seconds from `from` to `to` leaving at `time`, or UNREACHED; its
+// first leg's departure goes to `departure`
+static int32_t earliestArrival(const Timetable& timetable, int from, int to, const char* time, int horizon_seconds,
+                               const RaptorCriteria& criteria, int32_t* departure = nullptr) {
+    std::map<int, std::vector<Journey>> final_profiles;
+    RoundLabels labels;
+    runMultiCriteriaRaptor(from, to, Time(time), timetable, final_profiles, labels, horizon_seconds, criteria);
+    int32_t best = UNREACHED;
+    for (const Journey& journey : final_profiles[to]) {
+        if (journey.arrival_time.toSeconds() >= best) continue;
+        best = journey.arrival_time.toSeconds();
+        std::vector<JourneyLeg> legs = reconstructLegs(journey, labels, timetable);
+        if (departure && !legs.empty()) *departure = legs.front().departure_time.toSeconds();
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::fprintf(stderr, "usage: %s <directory>\n", argv[0]);
+        return 2;
+    }
+    const std::string dir = argv[1];
+    // Stops far enough apart that nothing is walkable. The night trip leaves A before midnight and
+    // reaches B and C after it; the morning trip is the only other service.
+    writeFile(dir, "stops.txt",
+              "stop_id,stop_name,stop_lat,stop_lon\n"
+              "1,A,10.0,10.0\n2,B,10.1,10.0\n3,C,10.2,10.0\n");
+    writeFile(dir, "stop_times.txt",
+              "trip_id,arrival_time,departure_time,stop_id,stop_sequence\n"
+              "NIGHT,23:50:00,23:50:00,1,1\n"
+              "NIGHT,24:10:00,24:10:00,2,2\n"
+              "NIGHT,24:30:00,24:30:00,3,3\n"
+              "MORNING,06:00:00,06:00:00,1,1\n"
+              "MORNING,06:15:00,06:15:00,2,2\n"
+              "MORNING,06:30:00,06:30:00,3,3\n");
+    auto timetable = loadTimetable(dir, 1);
+    const int DAY = SECONDS_PER_DAY;
+    const int HOUR = 3600;
+    RaptorCriteria walking;
+    walking.walking = true;
+
+    for (const RaptorCriteria& criteria : {RaptorCriteria(), walking}) {
+        // Tonight's trip, with its times past 24:00:00 kept as they are
+        int32_t departure = 0;
+        CHECK(earliestArrival(*timetable, 1, 3, "23:45:00", DEFAULT_HORIZON_SECONDS, criteria, &departure) == Time("24:30:00").toSeconds());
+        CHECK(departure == Time("23:50:00").toSeconds());
+
+        // Shortly after midnight, yesterday's night trip is still on its way from B to C
+        CHECK(earliestArrival(*timetable, 2, 3, "00:05:00", DEFAULT_HORIZON_SECONDS, criteria, &departure) == Time("00:30:00").toSeconds());
+        CHECK(departure == Time("00:10:00").toSeconds());
+        // ... but it has left B once that is past, and the next service is this morning's
+        CHECK(earliestArrival(*timetable, 2, 3, "00:15:00", DEFAULT_HORIZON_SECONDS, criteria) == Time("06:30:00").toSeconds());
+
+        // Missing tonight's trip leaves tomorrow morning's, if the horizon reaches that far
+        CHECK(earliestArrival(*timetable, 1, 3, "23:55:00", 6 * HOUR, criteria) == UNREACHED);
+        CHECK(earliestArrival(*timetable, 1, 3, "23:55:00", 12 * HOUR, criteria, &departure) == DAY + Time("06:30:00").toSeconds());
+        CHECK(departure == DAY + Time("06:00:00").toSeconds());
+
+        // A query time two days on, with a horizon of several days, finds that day's first trip
+        CHECK(earliestArrival(*timetable, 1, 3, "48:00:00", 3 * DAY, criteria, &departure) == 2 * DAY + Time("06:30:00").toSeconds());
+        CHECK(departure == 2 * DAY + Time("06:00:00").toSeconds());
+    }
+    return checkFailures();
+}
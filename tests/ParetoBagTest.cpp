@@ -0,0 +1,90 @@
+// ParetoBag::insert: dominance on (arrival, trips) and the extra criteria, order, and eviction
+#include "ParetoBag.h"
+#include "Check.h"
+
+static Label label(int arrival, int trips, int walk_meters = 0, int fare = 0) {
+    Label result = {};
+    result.arrival = arrival;
+    result.trips = static_cast<int16_t>(trips);
+    result.walk_meters = walk_meters;
+    result.fare = fare;
+    return result;
+}
+
+// True if the bag holds exactly these (arrival, trips) pairs, in this order
+static bool holds(const ParetoBag& bag, std::initializer_list<std::pair<int, int>> expected) {
+    if (bag.size() != expected.size()) return false;
+    auto it = bag.begin();
+    for (const auto& pair : expected) {
+        if (it->arrival != pair.first || it->trips != pair.second) return false;
+        ++it;
+    }
+    return true;
+}
+
+int main() {
+    const RaptorCriteria none;
+    RaptorCriteria walking;
+    walking.walking = true;
+    RaptorCriteria fare;
+    fare.fare = true;
+
+    {
+        // Trade-offs between arrival and trips are kept, sorted by arrival
+        ParetoBag bag;
+        CHECK(bag.insert(label(100, 2), none));
+        CHECK(bag.insert(label(120, 1), none));
+        CHECK(bag.insert(label(90, 3), none));
+        CHECK(holds(bag, {{90, 3}, {100, 2}, {120, 1}}));
+        CHECK(bag.front().arrival == 90);
+    }
+    {
+        // Dominated and equal labels are rejected and leave the bag unchanged
+        ParetoBag bag;
+        CHECK(bag.insert(label(100, 1), none));
+        CHECK(!bag.insert(label(110, 1), none));
+        CHECK(!bag.insert(label(100, 2), none));
+        CHECK(!bag.insert(label(100, 1), none));
+        CHECK(holds(bag, {{100, 1}}));
+    }
+    {
+        // A new label evicts everything it dominates, wherever it sits
+        ParetoBag bag;
+        CHECK(bag.insert(label(90, 4), none));
+        CHECK(bag.insert(label(100, 3), none));
+        CHECK(bag.insert(label(110, 2), none));
+        CHECK(bag.insert(label(120, 1), none));
+        CHECK(bag.insert(label(95, 2), none));
+        CHECK(holds(bag, {{90, 4}, {95, 2}, {120, 1}}));
+        CHECK(bag.insert(label(80, 1), none));
+        CHECK(holds(bag, {{80, 1}}));
+    }
+    {
+        // Extra criteria keep labels that only win on walking or fare
+        ParetoBag bag;
+        CHECK(bag.insert(label(100, 1, 500), walking));
+        CHECK(bag.insert(label(110, 1, 100), walking));
+        CHECK(!bag.insert(label(120, 1, 300), walking));
+        CHECK(bag.insert(label(100, 1, 400), walking)); // same (arrival, trips), less walking
+        CHECK(holds(bag, {{100, 1}, {110, 1}}));
+        CHECK(bag.begin()->walk_meters == 400);
+
+        ParetoBag fares;
+        CHECK(fares.insert(label(100, 1, 0, 250), fare));
+        CHECK(fares.insert(label(130, 1, 0, 120), fare));
+        CHECK(!fares.insert(label(130, 2, 0, 120), fare));
+        CHECK(!fares.insert(label(100, 1, 999, 250), fare)); // walking is not a criterion here
+    }
+    {
+        // dominated() agrees with insert() and clear() empties the bag
+        ParetoBag bag;
+        bag.insert(label(100, 2), none);
+        CHECK(bag.dominated(label(100, 2), none));
+        CHECK(bag.dominated(label(150, 3), none));
+        CHECK(!bag.dominated(label(150, 1), none));
+        CHECK(!bag.dominated(label(90, 5), none));
+        bag.clear();
+        CHECK(bag.empty());
+    }
+    return checkFailures();
+}
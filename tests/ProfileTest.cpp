@@ -0,0 +1,69 @@
+// Profile searches against single-departure searches: every lane of a profile query must find
+// the same (arrival, trips) options as a plain search leaving at that lane's time, on a random
+// feed with dense transfers and short walks at either end. Usage: ProfileTest <empty directory>
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Raptor.h"
+#include "Timetable.h"
+#include "Check.h"
+#include "RandomFeed.h"
+
+typedef std::vector<std::pair<int, int>> Options; // (trips, arrival seconds), sorted
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::fprintf(stderr, "usage: %s <directory>\n", argv[0]);
+        return 2;
+    }
+    const std::string dir = argv[1];
+    const int STOPS = 300, LANES = 24;
+    writeRandomFeed(dir, 5, STOPS, 40, 500);
+    auto timetable = loadTimetable(dir, 1);
+    RaptorLimits limits;
+    limits.max_trips = 4;
+    limits.max_walk_meters = 400;
+
+    std::mt19937 random(17);
+    RoundLabels labels;
+    int options_found = 0;
+    for (int query = 0; query < 60; ++query) {
+        int from = 1 + static_cast<int>(random() % STOPS), to = 1 + static_cast<int>(random() % STOPS);
+        if (from == to) continue;
+        // Uneven gaps between departures
+        std::vector<Time> departures;
+        int time = 6 * 3600 + static_cast<int>(random() % 3600);
+        for (int d = 0; d < LANES; ++d, time += 1 + static_cast<int>(random() % 240)) departures.push_back(Time::fromSeconds(time));
+
+        std::vector<ProfileJourney> profile;
+        CHECK(runProfileRaptor(from, to, departures, *timetable, profile, DEFAULT_HORIZON_SECONDS, limits));
+        std::vector<Options> lanes(LANES);
+        for (const ProfileJourney& journey : profile) {
+            auto lane = std::find_if(departures.begin(), departures.end(), [&](const Time& departure) {
+                return departure.toSeconds() == journey.departure_time.toSeconds();
+            });
+            CHECK(lane != departures.end());
+            if (lane == departures.end()) continue;
+            lanes[lane - departures.begin()].push_back({journey.trips, journey.arrival_time.toSeconds()});
+        }
+
+        for (int d = 0; d < LANES; ++d) {
+            std::map<int, std::vector<Journey>> final_profiles;
+            runMultiCriteriaRaptor(from, to, departures[d], *timetable, final_profiles, labels, DEFAULT_HORIZON_SECONDS, RaptorCriteria(), nullptr, limits);
+            Options expected;
+            for (const Journey& journey : final_profiles[to]) expected.push_back({journey.trips, journey.arrival_time.toSeconds()});
+            std::sort(expected.begin(), expected.end());
+            Options& found = lanes[d];
+            std::sort(found.begin(), found.end());
+            if (found != expected) std::fprintf(stderr, "%d -> %d at %d differs\n", from, to, departures[d].toSeconds());
+            CHECK(found == expected);
+            options_found += static_cast<int>(expected.size());
+        }
+    }
+    // Most lanes must have found something for the comparison to mean anything
+    CHECK(options_found > 60 * LANES);
+    return checkFailures();
+}
@@ -0,0 +1,64 @@
+#ifndef RANDOM_FEED_H_INCLUDED
+#define RANDOM_FEED_H_INCLUDED
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// A small random city for checking search modes against each other: stops scattered over a few
+// kilometers, lines through random stops in both directions between 06:00 and 09:00, and
+// transfers between every pair of stops closer than `transfer_meters`. Stop ids run from 1 to
+// `stop_count`. Only the raw engine output is used, so the same seed gives the same feed with
+// every standard library.
+inline void writeRandomFeed(const std::string& dir, unsigned seed, int stop_count, int line_count, double transfer_meters) {
+    const double SIDE_METERS = 4000, METERS_PER_DEGREE = 111320, LAT = 10.0, LON = 10.0;
+    std::mt19937 random(seed);
+    std::vector<double> x(stop_count), y(stop_count);
+    std::FILE* file = std::fopen((dir + "/stops.txt").c_str(), "w");
+    std::fputs("stop_id,stop_name,stop_lat,stop_lon\n", file);
+    for (int i = 0; i < stop_count; ++i) {
+        x[i] = random() % 100000 * SIDE_METERS / 100000;
+        y[i] = random() % 100000 * SIDE_METERS / 100000;
+        std::fprintf(file, "%d,S%d,%.7f,%.7f\n", i + 1, i + 1, LAT + y[i] / METERS_PER_DEGREE,
+                     LON + x[i] / (METERS_PER_DEGREE * std::cos(LAT * 3.14159265358979 / 180)));
+    }
+    std::fclose(file);
+
+    file = std::fopen((dir + "/transfers.txt").c_str(), "w");
+    std::fputs("from_stop_id,to_stop_id,transfer_type,min_transfer_time\n", file);
+    for (int i = 0; i < stop_count; ++i) {
+        for (int j = 0; j < stop_count; ++j) {
+            double meters = std::hypot(x[i] - x[j], y[i] - y[j]);
+            if (i != j && meters < transfer_meters) std::fprintf(file, "%d,%d,2,%d\n", i + 1, j + 1, 60 + static_cast<int>(meters / 1.4));
+        }
+    }
+    std::fclose(file);
+
+    file = std::fopen((dir + "/stop_times.txt").c_str(), "w");
+    std::fputs("trip_id,arrival_time,departure_time,stop_id,stop_sequence\n", file);
+    for (int line = 0; line < line_count; ++line) {
+        std::vector<int> line_stops;
+        for (int i = 0; i < 10; ++i) line_stops.push_back(static_cast<int>(random() % stop_count));
+        const int headway = 300 + static_cast<int>(random() % 900);
+        for (int direction = 0; direction < 2; ++direction) {
+            int trip = 0;
+            for (int start = 6 * 3600 + static_cast<int>(random() % headway); start < 9 * 3600; start += headway, ++trip) {
+                int time = start;
+                for (int i = 0; i < 10; ++i) {
+                    int stop = line_stops[direction == 0 ? i : 9 - i];
+                    if (i > 0) {
+                        int previous = line_stops[direction == 0 ? i - 1 : 10 - i];
+                        time += 30 + static_cast<int>(std::hypot(x[stop] - x[previous], y[stop] - y[previous]) / 8);
+                    }
+                    std::fprintf(file, "L%d_%d_%d,%02d:%02d:%02d,%02d:%02d:%02d,%d,%d\n", line, direction, trip,
+                                 time / 3600, time / 60 % 60, time % 60, time / 3600, time / 60 % 60, time % 60, stop + 1, i + 1);
+                }
+            }
+        }
+    }
+    std::fclose(file);
+}
+
+#endif // RANDOM_FEED_H_INCLUDED
@@ -0,0 +1,71 @@
+// TimetableStore reloads: a new feed is published as a new version while a timetable pinned
+// before the reload keeps answering from the old one, and a broken feed keeps the current one.
+// Usage: ReloadTest <empty directory>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Raptor.h"
+#include "Timetable.h"
+#include "Check.h"
+
+// Earliest arrival in seconds from 1 to 2 leaving at 07:55, or UNREACHED
+static int32_t arrivalAtB(const Timetable& timetable) {
+    std::map<int, std::vector<Journey>> final_profiles;
+    RoundLabels labels;
+    runMultiCriteriaRaptor(1, 2, Time("07:55:00"), timetable, final_profiles, labels);
+    int32_t best = UNREACHED;
+    for (const Journey& journey : final_profiles[2]) best = std::min(best, journey.arrival_time.toSeconds());
+    return best;
+}
+
+// Waits up to ten seconds for the store's reload thread to finish
+static bool waitForReload(const TimetableStore& store) {
+    for (int i = 0; i < 1000 && store.reloading(); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return !store.reloading();
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::fprintf(stderr, "usage: %s <directory>\n", argv[0]);
+        return 2;
+    }
+    const std::string dir = argv[1];
+    writeFile(dir, "stops.txt", "stop_id,stop_name,stop_lat,stop_lon\n1,A,10.0,10.0\n2,B,10.1,10.0\n");
+    writeFile(dir, "stop_times.txt",
+              "trip_id,arrival_time,departure_time,stop_id,stop_sequence\n"
+              "SLOW,08:00:00,08:00:00,1,1\nSLOW,08:30:00,08:30:00,2,2\n");
+
+    TimetableStore store(dir);
+    store.publish(loadTimetable(store.dataDir(), 1));
+    const std::shared_ptr<const Timetable> pinned = store.current();
+    CHECK(pinned->version == 1 && arrivalAtB(*pinned) == Time("08:30:00").toSeconds());
+
+    // The new feed is published as version 2; the pinned snapshot is untouched
+    writeFile(dir, "stop_times.txt",
+              "trip_id,arrival_time,departure_time,stop_id,stop_sequence\n"
+              "FAST,08:00:00,08:00:00,1,1\nFAST,08:10:00,08:10:00,2,2\n");
+    CHECK(store.reloadAsync());
+    CHECK(waitForReload(store));
+    std::shared_ptr<const Timetable> reloaded = store.current();
+    CHECK(reloaded->version == 2 && store.lastError().empty());
+    CHECK(arrivalAtB(*reloaded) == Time("08:10:00").toSeconds());
+    CHECK(pinned->version == 1 && arrivalAtB(*pinned) == Time("08:30:00").toSeconds());
+    CHECK(reloaded->strings.find("FAST") != NO_STRING && pinned->strings.find("FAST") == NO_STRING);
+
+    // A feed that fails to load leaves version 2 in place and reports why
+    writeFile(dir, "stops.txt", "stop_name,stop_lat,stop_lon\nA,10.0,10.0\n");
+    CHECK(store.reloadAsync());
+    CHECK(waitForReload(store));
+    CHECK(store.current() == reloaded);
+    CHECK(store.lastError().find("stops.txt") != std::string::npos);
+
+    // A good feed again clears the error and takes the next version
+    writeFile(dir, "stops.txt", "stop_id,stop_name,stop_lat,stop_lon\n1,A,10.0,10.0\n2,B,10.1,10.0\n");
+    CHECK(store.reloadAsync());
+    CHECK(waitForReload(store));
+    CHECK(store.current()->version == 3 && store.lastError().empty());
+    return checkFailures();
+}
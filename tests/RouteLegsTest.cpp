@@ -0,0 +1,73 @@
+// Legs rebuilt from a search on a pattern that visits a stop twice: boarding must happen at the
+// visit the search used, not the first one. Usage: RouteLegsTest <empty directory>
+#include <map>
+#include <string>
+#include <vector>
+#include "Raptor.h"
+#include "Timetable.h"
+#include "Check.h"
+
+// The legs of the single journey from `from` to `to` leaving at `time`, or none
+static std::vector<JourneyLeg> route(const Timetable& timetable, int from, int to, const char* time, const RaptorCriteria& criteria) {
+    std::map<int, std::vector<Journey>> final_profiles;
+    RoundLabels labels;
+    runMultiCriteriaRaptor(from, to, Time(time), timetable, final_profiles, labels, DEFAULT_HORIZON_SECONDS, criteria);
+    auto journeys = final_profiles.find(to);
+    if (journeys == final_profiles.end() || journeys->second.size() != 1) return {};
+    return reconstructLegs(journeys->second[0], labels, timetable, true);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::fprintf(stderr, "usage: %s <directory>\n", argv[0]);
+        return 2;
+    }
+    const std::string dir = argv[1];
+    // Stops far enough apart that nothing is walkable; the trip passes A twice
+    writeFile(dir, "stops.txt",
+              "stop_id,stop_name,stop_lat,stop_lon\n"
+              "1,A,10.0,10.0\n2,B,10.1,10.0\n3,C,10.2,10.0\n4,D,10.3,10.0\n");
+    writeFile(dir, "stop_times.txt",
+              "trip_id,arrival_time,departure_time,stop_id,stop_sequence\n"
+              "T1,08:00:00,08:00:00,1,1\n"
+              "T1,08:10:00,08:10:00,2,2\n"
+              "T1,08:20:00,08:20:00,3,3\n"
+              "T1,08:30:00,08:31:00,1,4\n"
+              "T1,08:40:00,08:40:00,4,5\n");
+    auto timetable = loadTimetable(dir, 1);
+    RaptorCriteria walking;
+    walking.walking = true;
+
+    for (const RaptorCriteria& criteria : {RaptorCriteria(), walking}) {
+        // Too late for the first visit of A: the leg starts at the second one
+        std::vector<JourneyLeg> legs = route(*timetable, 1, 4, "08:25:00", criteria);
+        CHECK(legs.size() == 1);
+        if (legs.size() == 1) {
+            CHECK(legs[0].method == METHOD_TRIP && legs[0].from_stop_id == 1 && legs[0].to_stop_id == 4);
+            CHECK(legs[0].departure_time.toSeconds() == Time("08:31:00").toSeconds());
+            CHECK(legs[0].arrival_time.toSeconds() == Time("08:40:00").toSeconds());
+            CHECK(legs[0].stops.empty());
+        }
+
+        // In time for the first visit: the trip is boarded there and passes B, C and A again
+        legs = route(*timetable, 1, 4, "07:55:00", criteria);
+        CHECK(legs.size() == 1);
+        if (legs.size() == 1) {
+            CHECK(legs[0].departure_time.toSeconds() == Time("08:00:00").toSeconds());
+            CHECK(legs[0].stops.size() == 3);
+            if (legs[0].stops.size() == 3) {
+                CHECK(legs[0].stops[0].stop_id == 2 && legs[0].stops[1].stop_id == 3 && legs[0].stops[2].stop_id == 1);
+                CHECK(legs[0].stops[2].departure_time.toSeconds() == Time("08:31:00").toSeconds());
+            }
+        }
+
+        // Alighting at the second visit of A, from C
+        legs = route(*timetable, 3, 1, "08:15:00", criteria);
+        CHECK(legs.size() == 1);
+        if (legs.size() == 1) {
+            CHECK(legs[0].departure_time.toSeconds() == Time("08:20:00").toSeconds());
+            CHECK(legs[0].arrival_time.toSeconds() == Time("08:30:00").toSeconds());
+        }
+    }
+    return checkFailures();
+}
@@ -0,0 +1,60 @@
+// Each worker thread reuses one set of search arrays across queries and timetables. Queries
+// alternating between two timetables of different sizes, with and without extra criteria, must
+// answer exactly like the same query on a thread that never searched before.
+// Usage: ScratchReuseTest <empty directory>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "Raptor.h"
+#include "Timetable.h"
+#include "Check.h"
+#include "RandomFeed.h"
+
+typedef std::vector<std::tuple<int, int, int, int>> Answer; // (trips, arrival, departure, walk_meters)
+
+static Answer search(const Timetable& timetable, int from, int to, int time, const RaptorCriteria& criteria) {
+    std::map<int, std::vector<Journey>> final_profiles;
+    RoundLabels labels;
+    runMultiCriteriaRaptor(from, to, Time::fromSeconds(time), timetable, final_profiles, labels, DEFAULT_HORIZON_SECONDS, criteria);
+    Answer answer;
+    for (const Journey& journey : final_profiles[to]) {
+        answer.emplace_back(journey.trips, journey.arrival_time.toSeconds(), journey.departure_time.toSeconds(), journey.walk_meters);
+    }
+    return answer;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::fprintf(stderr, "usage: %s <directory>\n", argv[0]);
+        return 2;
+    }
+    const std::string dir = argv[1];
+    // The second feed has fewer stops, so the arrays shrink in use but keep entries past its end
+    writeRandomFeed(dir, 7, 300, 30, 400);
+    auto large = loadTimetable(dir, 1);
+    writeRandomFeed(dir, 8, 120, 15, 400);
+    auto small = loadTimetable(dir, 2);
+    RaptorCriteria walking;
+    walking.walking = true;
+
+    std::mt19937 random(23);
+    int answered = 0;
+    for (int query = 0; query < 200; ++query) {
+        const Timetable& timetable = query % 2 ? *small : *large;
+        const int stops = query % 2 ? 120 : 300;
+        int from = 1 + static_cast<int>(random() % stops), to = 1 + static_cast<int>(random() % stops);
+        int time = 6 * 3600 + static_cast<int>(random() % 7200);
+        const RaptorCriteria& criteria = query % 4 < 2 ? RaptorCriteria() : walking;
+
+        Answer reused = search(timetable, from, to, time, criteria);
+        Answer fresh;
+        std::thread([&] { fresh = search(timetable, from, to, time, criteria); }).join();
+        CHECK(reused == fresh);
+        if (!reused.empty()) ++answered;
+    }
+    CHECK(answered > 100);
+    return checkFailures();
+}
@@ -0,0 +1,71 @@
+// The dispatched kernels (AVX2, SSE2 or scalar, whichever this CPU picks) against plain loops
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "Raptor.h"
+#include "SimdKernels.h"
+#include "Check.h"
+
+int main() {
+    std::mt19937 random(12345);
+    std::printf("kernels: %s\n", simdLevelName());
+
+    // firstAtLeast: every size around the vector widths and the linear-scan cutoff, keys below,
+    // inside (with duplicates) and above the range
+    for (int count = 0; count <= 200; ++count) {
+        std::vector<int32_t> values(count);
+        int32_t value = -50;
+        for (auto& v : values) v = value += static_cast<int32_t>(random() % 3);
+        for (int32_t key = -60; key <= value + 10; key += 1 + static_cast<int32_t>(random() % 4)) {
+            int expected = static_cast<int>(std::lower_bound(values.begin(), values.end(), key) - values.begin());
+            CHECK(firstAtLeast(values.data(), count, key) == expected);
+        }
+    }
+
+    // minMergeArrivals: result, return value and untouched input, with UNREACHED entries
+    for (int count = 0; count <= 100; ++count) {
+        for (int round = 0; round < 4; ++round) {
+            std::vector<int32_t> best(count), candidate(count);
+            for (int i = 0; i < count; ++i) {
+                best[i] = random() % 5 == 0 ? UNREACHED : static_cast<int32_t>(random() % 1000);
+                candidate[i] = random() % 5 == 0 ? UNREACHED : static_cast<int32_t>(random() % 1000 + round * 300);
+            }
+            std::vector<int32_t> expected = best;
+            bool expected_improved = false;
+            for (int i = 0; i < count; ++i) {
+                if (candidate[i] < expected[i]) {
+                    expected[i] = candidate[i];
+                    expected_improved = true;
+                }
+            }
+            const std::vector<int32_t> original_candidate = candidate;
+            CHECK(minMergeArrivals(best.data(), candidate.data(), count) == expected_improved);
+            CHECK(best == expected);
+            CHECK(candidate == original_candidate);
+        }
+    }
+
+    // filterNearbyStops never drops a stop haversine accepts, up to the largest supported radius
+    const double lat0 = 52.37, lon0 = 4.89;
+    std::vector<float> lats, lons;
+    for (int i = 0; i < 4000; ++i) {
+        if (i % 97 == 0) {
+            lats.push_back(NAN);
+            lons.push_back(NAN);
+            continue;
+        }
+        lats.push_back(static_cast<float>(lat0 + (random() % 40001 - 20000) * 0.00001 * 12));
+        lons.push_back(static_cast<float>(lon0 + (random() % 40001 - 20000) * 0.00001 * 20));
+    }
+    std::vector<int32_t> found(lats.size());
+    for (double radius : {300.0, 1500.0, 5000.0, NEARBY_FILTER_MAX_METERS}) {
+        int count = filterNearbyStops(lat0, lon0, lats.data(), lons.data(), static_cast<int>(lats.size()), radius, found.data());
+        CHECK(std::is_sorted(found.begin(), found.begin() + count));
+        for (size_t i = 0; i < lats.size(); ++i) {
+            if (std::isnan(lats[i]) || haversine(lat0, lon0, lats[i], lons[i]) > radius) continue;
+            CHECK(std::binary_search(found.begin(), found.begin() + count, static_cast<int32_t>(i)));
+        }
+    }
+    return checkFailures();
+}
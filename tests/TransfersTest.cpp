@@ -0,0 +1,90 @@
+// Transfers after trips at stops that were reached on foot first: a walk cannot be followed by a
+// transfer, so a later trip arrival there must still be walked on from. Checked on a small feed
+// built for it and, across many queries on a random one, by comparing plain searches with
+// walking-criterion searches, which must find the same earliest arrival for every trip count.
+// Usage: TransfersTest <empty directory>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "Raptor.h"
+#include "Timetable.h"
+#include "Check.h"
+#include "RandomFeed.h"
+
+// The search's journeys from `from` to `to` leaving at `time`
+static std::vector<Journey> search(const Timetable& timetable, int from, int to, int time, const RaptorCriteria& criteria,
+                                   const RaptorLimits& limits, RoundLabels& labels) {
+    std::map<int, std::vector<Journey>> final_profiles;
+    runMultiCriteriaRaptor(from, to, Time::fromSeconds(time), timetable, final_profiles, labels, DEFAULT_HORIZON_SECONDS, criteria, nullptr, limits);
+    return final_profiles[to];
+}
+
+// Earliest arrival with at most k trips, for every k up to `max_trips`
+static std::vector<int32_t> arrivalsByTrips(const std::vector<Journey>& journeys, int max_trips) {
+    std::vector<int32_t> arrivals(max_trips + 1, UNREACHED);
+    for (const Journey& journey : journeys) {
+        for (int k = journey.trips; k <= max_trips; ++k) arrivals[k] = std::min(arrivals[k], journey.arrival_time.toSeconds());
+    }
+    return arrivals;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::fprintf(stderr, "usage: %s <directory>\n", argv[0]);
+        return 2;
+    }
+    const std::string dir = argv[1];
+    RaptorCriteria walking;
+    walking.walking = true;
+    RoundLabels labels;
+
+    // O has no service of its own. P (300 m away) and S (200 m) are both reached by walking from
+    // it; the trip from P passes far-away A and ends at S, from where only a transfer reaches X.
+    // The trip arrives at S after the walk did, with more trips and no less walking.
+    writeFile(dir, "stops.txt",
+              "stop_id,stop_name,stop_lat,stop_lon\n"
+              "1,O,10.0,10.0\n2,S,10.0018,10.0\n3,A,10.05,10.0\n4,X,10.3,10.0\n5,P,10.0,10.00274\n");
+    writeFile(dir, "stop_times.txt",
+              "trip_id,arrival_time,departure_time,stop_id,stop_sequence\n"
+              "T1,08:00:00,08:00:00,5,1\nT1,08:10:00,08:10:00,3,2\nT1,08:20:00,08:20:00,2,3\n");
+    writeFile(dir, "transfers.txt", "from_stop_id,to_stop_id,min_transfer_time\n2,4,600\n");
+    {
+        auto timetable = loadTimetable(dir, 1);
+        for (const RaptorCriteria& criteria : {RaptorCriteria(), walking}) {
+            std::vector<Journey> journeys = search(*timetable, 1, 4, Time("07:50:00").toSeconds(), criteria, RaptorLimits(), labels);
+            CHECK(journeys.size() == 1);
+            if (journeys.size() != 1) continue;
+            CHECK(journeys[0].arrival_time.toSeconds() == Time("08:30:00").toSeconds() && journeys[0].trips == 1);
+            std::vector<JourneyLeg> legs = reconstructLegs(journeys[0], labels, *timetable);
+            CHECK(legs.size() == 3);
+            if (legs.size() != 3) continue;
+            CHECK(legs[0].method == METHOD_WALK && legs[0].to_stop_id == 5);
+            CHECK(legs[1].method == METHOD_TRIP && legs[1].from_stop_id == 5 && legs[1].to_stop_id == 2);
+            CHECK(legs[2].method == METHOD_WALK && legs[2].from_stop_id == 2 && legs[2].to_stop_id == 4);
+        }
+    }
+
+    // Random queries on a random city with dense transfers and short walks at either end
+    const int STOPS = 300, MAX_TRIPS = 4;
+    writeRandomFeed(dir, 3, STOPS, 40, 500);
+    auto timetable = loadTimetable(dir, 2);
+    RaptorLimits limits;
+    limits.max_trips = MAX_TRIPS;
+    limits.max_walk_meters = 400;
+    std::mt19937 random(11);
+    int compared = 0;
+    for (int query = 0; query < 300; ++query) {
+        int from = 1 + static_cast<int>(random() % STOPS), to = 1 + static_cast<int>(random() % STOPS);
+        int time = 6 * 3600 + static_cast<int>(random() % 7200);
+        if (from == to) continue;
+        std::vector<int32_t> plain = arrivalsByTrips(search(*timetable, from, to, time, RaptorCriteria(), limits, labels), MAX_TRIPS);
+        std::vector<int32_t> with_walking = arrivalsByTrips(search(*timetable, from, to, time, walking, limits, labels), MAX_TRIPS);
+        if (plain != with_walking) std::fprintf(stderr, "%d -> %d at %d differs\n", from, to, time);
+        CHECK(plain == with_walking);
+        if (plain[MAX_TRIPS] != UNREACHED) ++compared;
+    }
+    // Most queries must have found something for the comparison to mean anything
+    CHECK(compared > 200);
+    return checkFailures();
+}